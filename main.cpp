@@ -12,12 +12,12 @@
 #include "src/zobrist.h"
 #include "src/evaluation.h"
 #include "src/uci.h"
+#include "src/nnue.h"
 
 int main(int argc, char* argv[])
 {
-    mg_init();
-    Zobrist::init();
-    bb_init();
+    Pext::init();
+    NNUE::init();
     uci();
     return 0;
 } 
\ No newline at end of file
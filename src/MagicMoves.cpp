@@ -27,6 +27,7 @@
  *3. This notice may not be removed or altered from any source distribution.
  */
 
+#include <utility>
 #include "MagicMoves.hpp"
 
 #ifdef _MSC_VER
@@ -49,7 +50,7 @@
 //C64(0x007FFCDDFCED714A) - B8 10 bit
 //C64(0x003FFFCDFFD88096) - C8 10 bit
 
-const unsigned int magicmoves_r_shift[64]=
+constexpr unsigned int magicmoves_r_shift[64]=
 {
 	52, 53, 53, 53, 53, 53, 53, 52,
 	53, 54, 54, 54, 54, 54, 54, 53,
@@ -61,7 +62,7 @@ const unsigned int magicmoves_r_shift[64]=
 	53, 54, 54, 53, 53, 53, 53, 53
 };
 
-const U64 magicmoves_r_magics[64]=
+constexpr U64 magicmoves_r_magics[64]=
 {
 	C64(0x0080001020400080), C64(0x0040001000200040), C64(0x0080081000200080), C64(0x0080040800100080),
 	C64(0x0080020400080080), C64(0x0080010200040080), C64(0x0080008001000200), C64(0x0080002040800100),
@@ -80,7 +81,7 @@ const U64 magicmoves_r_magics[64]=
 	C64(0x00FFFCDDFCED714A), C64(0x007FFCDDFCED714A), C64(0x003FFFCDFFD88096), C64(0x0000040810002101),
 	C64(0x0001000204080011), C64(0x0001000204000801), C64(0x0001000082000401), C64(0x0001FFFAABFAD1A2)
 };
-const U64 magicmoves_r_mask[64]=
+constexpr U64 magicmoves_r_mask[64]=
 {	
 	C64(0x000101010101017E), C64(0x000202020202027C), C64(0x000404040404047A), C64(0x0008080808080876),
 	C64(0x001010101010106E), C64(0x002020202020205E), C64(0x004040404040403E), C64(0x008080808080807E),
@@ -101,7 +102,7 @@ const U64 magicmoves_r_mask[64]=
 };
 
 //my original tables for bishops
-const unsigned int magicmoves_b_shift[64]=
+constexpr unsigned int magicmoves_b_shift[64]=
 {
 	58, 59, 59, 59, 59, 59, 59, 58,
 	59, 59, 59, 59, 59, 59, 59, 59,
@@ -113,7 +114,7 @@ const unsigned int magicmoves_b_shift[64]=
 	58, 59, 59, 59, 59, 59, 59, 58
 };
 
-const U64 magicmoves_b_magics[64]=
+constexpr U64 magicmoves_b_magics[64]=
 {
 	C64(0x0002020202020200), C64(0x0002020202020000), C64(0x0004010202000000), C64(0x0004040080000000),
 	C64(0x0001104000000000), C64(0x0000821040000000), C64(0x0000410410400000), C64(0x0000104104104000),
@@ -134,7 +135,7 @@ const U64 magicmoves_b_magics[64]=
 };
 
 
-const U64 magicmoves_b_mask[64]=
+constexpr U64 magicmoves_b_mask[64]=
 {
 	C64(0x0040201008040200), C64(0x0000402010080400), C64(0x0000004020100A00), C64(0x0000000040221400),
 	C64(0x0000000002442800), C64(0x0000000204085000), C64(0x0000020408102000), C64(0x0002040810204000),
@@ -154,79 +155,23 @@ const U64 magicmoves_b_mask[64]=
 	C64(0x0028440200000000), C64(0x0050080402000000), C64(0x0020100804020000), C64(0x0040201008040200)
 };
 
-#ifdef MINIMIZE_MAGIC
-U64 magicmovesbdb[5248];
-const U64* magicmoves_b_indices[64]=
-{
-	magicmovesbdb+4992, magicmovesbdb+2624,  magicmovesbdb+256,  magicmovesbdb+896,
-	magicmovesbdb+1280, magicmovesbdb+1664, magicmovesbdb+4800, magicmovesbdb+5120,
-	magicmovesbdb+2560, magicmovesbdb+2656,  magicmovesbdb+288,  magicmovesbdb+928,
-	magicmovesbdb+1312, magicmovesbdb+1696, magicmovesbdb+4832, magicmovesbdb+4928,
-	magicmovesbdb+0,     magicmovesbdb+128,  magicmovesbdb+320,  magicmovesbdb+960,
-	magicmovesbdb+1344, magicmovesbdb+1728, magicmovesbdb+2304, magicmovesbdb+2432,
-	magicmovesbdb+32,    magicmovesbdb+160,  magicmovesbdb+448, magicmovesbdb+2752,
-	magicmovesbdb+3776, magicmovesbdb+1856, magicmovesbdb+2336, magicmovesbdb+2464,
-	magicmovesbdb+64,    magicmovesbdb+192,  magicmovesbdb+576, magicmovesbdb+3264,
-	magicmovesbdb+4288, magicmovesbdb+1984, magicmovesbdb+2368, magicmovesbdb+2496,
-	magicmovesbdb+96,    magicmovesbdb+224,  magicmovesbdb+704, magicmovesbdb+1088,
-	magicmovesbdb+1472, magicmovesbdb+2112, magicmovesbdb+2400, magicmovesbdb+2528,
-	magicmovesbdb+2592, magicmovesbdb+2688,  magicmovesbdb+832, magicmovesbdb+1216,
-	magicmovesbdb+1600, magicmovesbdb+2240, magicmovesbdb+4864, magicmovesbdb+4960,
-	magicmovesbdb+5056, magicmovesbdb+2720,  magicmovesbdb+864, magicmovesbdb+1248,
-	magicmovesbdb+1632, magicmovesbdb+2272, magicmovesbdb+4896, magicmovesbdb+5184
-};
-#else
-	#ifndef PERFECT_MAGIC_HASH
-		U64 magicmovesbdb[64][1<<9];
-	#else
-		U64 magicmovesbdb[1428];
-		PERFECT_MAGIC_HASH magicmoves_b_indices[64][1<<9];
-	#endif
-#endif
-
-#ifdef MINIMIZE_MAGIC
-U64 magicmovesrdb[102400];
-const U64* magicmoves_r_indices[64]=
-{
-	magicmovesrdb+86016, magicmovesrdb+73728, magicmovesrdb+36864, magicmovesrdb+43008,
-	magicmovesrdb+47104, magicmovesrdb+51200, magicmovesrdb+77824, magicmovesrdb+94208,
-	magicmovesrdb+69632, magicmovesrdb+32768, magicmovesrdb+38912, magicmovesrdb+10240,
-	magicmovesrdb+14336, magicmovesrdb+53248, magicmovesrdb+57344, magicmovesrdb+81920,
-	magicmovesrdb+24576, magicmovesrdb+33792,  magicmovesrdb+6144, magicmovesrdb+11264,
-	magicmovesrdb+15360, magicmovesrdb+18432, magicmovesrdb+58368, magicmovesrdb+61440,
-	magicmovesrdb+26624,  magicmovesrdb+4096,  magicmovesrdb+7168,     magicmovesrdb+0,
-	 magicmovesrdb+2048, magicmovesrdb+19456, magicmovesrdb+22528, magicmovesrdb+63488,
-	magicmovesrdb+28672,  magicmovesrdb+5120,  magicmovesrdb+8192,  magicmovesrdb+1024,
-	 magicmovesrdb+3072, magicmovesrdb+20480, magicmovesrdb+23552, magicmovesrdb+65536,
-	magicmovesrdb+30720, magicmovesrdb+34816,  magicmovesrdb+9216, magicmovesrdb+12288,
-	magicmovesrdb+16384, magicmovesrdb+21504, magicmovesrdb+59392, magicmovesrdb+67584,
-	magicmovesrdb+71680, magicmovesrdb+35840, magicmovesrdb+39936, magicmovesrdb+13312,
-	magicmovesrdb+17408, magicmovesrdb+54272, magicmovesrdb+60416, magicmovesrdb+83968,
-	magicmovesrdb+90112, magicmovesrdb+75776, magicmovesrdb+40960, magicmovesrdb+45056,
-	magicmovesrdb+49152, magicmovesrdb+55296, magicmovesrdb+79872, magicmovesrdb+98304
-};
-#else
-	#ifndef PERFECT_MAGIC_HASH
-		U64 magicmovesrdb[64][1<<12];
-	#else
-		U64 magicmovesrdb[4900];
-		PERFECT_MAGIC_HASH magicmoves_r_indices[64][1<<12];
-	#endif
-#endif
+//Altered from the original: the databases are generated at compile time
+//instead of by initmagicmoves(), so they are read-only data shared by every
+//process and there is nothing to initialize at startup.
 
-U64 initmagicmoves_occ(const int* squares, const int numSquares, const U64 linocc)
+static constexpr U64 initmagicmoves_occ(const int* squares, const int numSquares, const U64 linocc)
 {
-	int i;
+	int i=0;
 	U64 ret=0;
 	for(i=0;i<numSquares;i++)
 		if(linocc&(((U64)(1))<<i)) ret|=(((U64)(1))<<squares[i]);
 	return ret;
 }
 
-U64 initmagicmoves_Rmoves(const int square, const U64 occ)
+static constexpr U64 initmagicmoves_Rmoves(const int square, const U64 occ)
 {
 	U64 ret=0;
-	U64 bit;
+	U64 bit=0;
 	U64 rowbits=(((U64)0xFF)<<(8*(square/8)));
 	
 	bit=(((U64)(1))<<square);
@@ -258,11 +203,11 @@ U64 initmagicmoves_Rmoves(const int square, const U64 occ)
 	return ret;
 }
 
-U64 initmagicmoves_Bmoves(const int square, const U64 occ)
+static constexpr U64 initmagicmoves_Bmoves(const int square, const U64 occ)
 {
 	U64 ret=0;
-	U64 bit;
-	U64 bit2;
+	U64 bit=0;
+	U64 bit2=0;
 	U64 rowbits=(((U64)0xFF)<<(8*(square/8)));
 	
 	bit=(((U64)(1))<<square);
@@ -304,93 +249,31 @@ U64 initmagicmoves_Bmoves(const int square, const U64 occ)
 	return ret;
 }
 
-//used so that the original indices can be left as const so that the compiler can optimize better
-
-#ifndef PERFECT_MAGIC_HASH
-	#ifdef MINIMIZE_MAGIC
-		#define BmagicNOMASK2(square, occupancy) *(magicmoves_b_indices2[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
-		#define RmagicNOMASK2(square, occupancy) *(magicmoves_r_indices2[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
-	#else
-		#define BmagicNOMASK2(square, occupancy) magicmovesbdb[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]
-		#define RmagicNOMASK2(square, occupancy) magicmovesrdb[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]
-	#endif
-/*#else
-	#define BmagicNOMASK2(square, occupancy) magicmovesbdb[magicmoves_b_indices[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT]]
-	#define RmagicNOMASK2(square, occupancy) magicmovesrdb[magicmoves_r_indices[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT]]
-*/
-#endif
-
-void initmagicmoves(void)
+//Each square's database is a separate constant, so no single compile time
+//evaluation grows past the compiler's limits.
+template<int square, bool rook>
+struct magicmoves_square_database
 {
-	int i;
-
-	//for bitscans :
-	//initmagicmoves_bitpos64_database[(x*C64(0x07EDD5E59A4E28C2))>>58]
-	int initmagicmoves_bitpos64_database[64]={
-	63,  0, 58,  1, 59, 47, 53,  2,
-	60, 39, 48, 27, 54, 33, 42,  3,
-	61, 51, 37, 40, 49, 18, 28, 20,
-	55, 30, 34, 11, 43, 14, 22,  4,
-	62, 57, 46, 52, 38, 26, 32, 41,
-	50, 36, 17, 19, 29, 10, 13, 21,
-	56, 45, 25, 31, 35, 16,  9, 12,
-	44, 24, 15,  8, 23,  7,  6,  5};
-
-#ifdef MINIMIZE_MAGIC
-	//identical to magicmove_x_indices except without the const modifer
-	U64* magicmoves_b_indices2[64]=
+	constexpr magicmoves_square_database() : moves{}
 	{
-		magicmovesbdb+4992, magicmovesbdb+2624,  magicmovesbdb+256,  magicmovesbdb+896,
-		magicmovesbdb+1280, magicmovesbdb+1664, magicmovesbdb+4800, magicmovesbdb+5120,
-		magicmovesbdb+2560, magicmovesbdb+2656,  magicmovesbdb+288,  magicmovesbdb+928,
-		magicmovesbdb+1312, magicmovesbdb+1696, magicmovesbdb+4832, magicmovesbdb+4928,
-		magicmovesbdb+0,     magicmovesbdb+128,  magicmovesbdb+320,  magicmovesbdb+960,
-		magicmovesbdb+1344, magicmovesbdb+1728, magicmovesbdb+2304, magicmovesbdb+2432,
-		magicmovesbdb+32,    magicmovesbdb+160,  magicmovesbdb+448, magicmovesbdb+2752,
-		magicmovesbdb+3776, magicmovesbdb+1856, magicmovesbdb+2336, magicmovesbdb+2464,
-		magicmovesbdb+64,    magicmovesbdb+192,  magicmovesbdb+576, magicmovesbdb+3264,
-		magicmovesbdb+4288, magicmovesbdb+1984, magicmovesbdb+2368, magicmovesbdb+2496,
-		magicmovesbdb+96,    magicmovesbdb+224,  magicmovesbdb+704, magicmovesbdb+1088,
-		magicmovesbdb+1472, magicmovesbdb+2112, magicmovesbdb+2400, magicmovesbdb+2528,
-		magicmovesbdb+2592, magicmovesbdb+2688,  magicmovesbdb+832, magicmovesbdb+1216,
-		magicmovesbdb+1600, magicmovesbdb+2240, magicmovesbdb+4864, magicmovesbdb+4960,
-		magicmovesbdb+5056, magicmovesbdb+2720,  magicmovesbdb+864, magicmovesbdb+1248,
-		magicmovesbdb+1632, magicmovesbdb+2272, magicmovesbdb+4896, magicmovesbdb+5184
-	};
-	U64* magicmoves_r_indices2[64]=
-	{
-		magicmovesrdb+86016, magicmovesrdb+73728, magicmovesrdb+36864, magicmovesrdb+43008,
-		magicmovesrdb+47104, magicmovesrdb+51200, magicmovesrdb+77824, magicmovesrdb+94208,
-		magicmovesrdb+69632, magicmovesrdb+32768, magicmovesrdb+38912, magicmovesrdb+10240,
-		magicmovesrdb+14336, magicmovesrdb+53248, magicmovesrdb+57344, magicmovesrdb+81920,
-		magicmovesrdb+24576, magicmovesrdb+33792,  magicmovesrdb+6144, magicmovesrdb+11264,
-		magicmovesrdb+15360, magicmovesrdb+18432, magicmovesrdb+58368, magicmovesrdb+61440,
-		magicmovesrdb+26624,  magicmovesrdb+4096,  magicmovesrdb+7168,     magicmovesrdb+0,
-		magicmovesrdb+2048,  magicmovesrdb+19456, magicmovesrdb+22528, magicmovesrdb+63488,
-		magicmovesrdb+28672,  magicmovesrdb+5120,  magicmovesrdb+8192,  magicmovesrdb+1024,
-		magicmovesrdb+3072,  magicmovesrdb+20480, magicmovesrdb+23552, magicmovesrdb+65536,
-		magicmovesrdb+30720, magicmovesrdb+34816,  magicmovesrdb+9216, magicmovesrdb+12288,
-		magicmovesrdb+16384, magicmovesrdb+21504, magicmovesrdb+59392, magicmovesrdb+67584,
-		magicmovesrdb+71680, magicmovesrdb+35840, magicmovesrdb+39936, magicmovesrdb+13312,
-		magicmovesrdb+17408, magicmovesrdb+54272, magicmovesrdb+60416, magicmovesrdb+83968,
-		magicmovesrdb+90112, magicmovesrdb+75776, magicmovesrdb+40960, magicmovesrdb+45056,
-		magicmovesrdb+49152, magicmovesrdb+55296, magicmovesrdb+79872, magicmovesrdb+98304
-	};
-#endif // MINIMIZE_MAGIC
+		//for bitscans :
+		//initmagicmoves_bitpos64_database[(x*C64(0x07EDD5E59A4E28C2))>>58]
+		const int initmagicmoves_bitpos64_database[64]={
+		63,  0, 58,  1, 59, 47, 53,  2,
+		60, 39, 48, 27, 54, 33, 42,  3,
+		61, 51, 37, 40, 49, 18, 28, 20,
+		55, 30, 34, 11, 43, 14, 22,  4,
+		62, 57, 46, 52, 38, 26, 32, 41,
+		50, 36, 17, 19, 29, 10, 13, 21,
+		56, 45, 25, 31, 35, 16,  9, 12,
+		44, 24, 15,  8, 23,  7,  6,  5};
 
+		const U64 mask=rook ? magicmoves_r_mask[square] : magicmoves_b_mask[square];
+		const U64 magic=rook ? magicmoves_r_magics[square] : magicmoves_b_magics[square];
 
-#ifdef PERFECT_MAGIC_HASH
-	for(i=0;i<1428;i++)
-		magicmovesbdb[i]=0;
-	for(i=0;i<4900;i++)
-		magicmovesrdb[i]=0;
-#endif
-
-	for(i=0;i<64;i++)
-	{
-		int squares[64];
+		int squares[64]={};
 		int numsquares=0;
-		U64 temp=magicmoves_b_mask[i];
+		U64 temp=mask;
 		while(temp)
 		{
 			U64 bit=temp&-temp;
@@ -400,69 +283,72 @@ void initmagicmoves(void)
 		for(temp=0;temp<(((U64)(1))<<numsquares);temp++)
 		{
 			U64 tempocc=initmagicmoves_occ(squares,numsquares,temp);
-			#ifndef PERFECT_MAGIC_HASH
-				BmagicNOMASK2(i,tempocc)=initmagicmoves_Bmoves(i,tempocc);
-			#else
-				U64 moves=initmagicmoves_Bmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_b_magics[i])>>MINIMAL_B_BITS_SHIFT);
-				int j;
-				for(j=0;j<1428;j++)
-				{
-					if(!magicmovesbdb[j])
-					{
-						magicmovesbdb[j]=moves;
-						magicmoves_b_indices[i][index]=j;
-						break;
-					}
-					else if(magicmovesbdb[j]==moves)
-					{
-						magicmoves_b_indices[i][index]=j;
-						break;
-					}
-				}
-			#endif
+			moves[(tempocc*magic)>>shift]=
+				rook ? initmagicmoves_Rmoves(square,tempocc) : initmagicmoves_Bmoves(square,tempocc);
 		}
 	}
-	for(i=0;i<64;i++)
+	static constexpr unsigned int shift=rook ? magicmoves_r_shift[square] : magicmoves_b_shift[square];
+	U64 moves[((U64)(1))<<(64-shift)];
+};
+
+template<int square>
+static constexpr magicmoves_square_database<square,false> magicmoves_b_database{};
+
+template<int square>
+static constexpr magicmoves_square_database<square,true> magicmoves_r_database{};
+
+//where each square's moves start in the combined database: all the bishop
+//squares in order, then all the rook squares
+static constexpr unsigned int magicmoves_offset(const bool rook, const int square)
+{
+	unsigned int offset=0;
+	for(int i=0;i<(rook ? 64 : square);i++)
+		offset+=1u<<(64-magicmoves_b_shift[i]);
+	for(int i=0;rook && i<square;i++)
+		offset+=1u<<(64-magicmoves_r_shift[i]);
+	return offset;
+}
+
+struct magicmoves_database
+{
+	U64 moves[magicmoves_offset(true,64)];
+};
+
+template<typename T>
+static constexpr int magicmoves_copy(magicmoves_database& db, const unsigned int offset, const T& square)
+{
+	for(unsigned int i=0;i<sizeof(square.moves)/sizeof(U64);i++)
+		db.moves[offset+i]=square.moves[i];
+	return 0;
+}
+
+//the per square constants are only read here, at compile time, so only the
+//combined database ends up in the program
+template<std::size_t... square>
+static constexpr magicmoves_database magicmoves_build(std::index_sequence<square...>)
+{
+	magicmoves_database db{};
+	const int copied[]=
 	{
-		int squares[64];
-		int numsquares=0;
-		U64 temp=magicmoves_r_mask[i];
-		while(temp)
-		{
-			U64 bit=temp&-temp;
-			squares[numsquares++]=initmagicmoves_bitpos64_database[(bit*C64(0x07EDD5E59A4E28C2))>>58];
-			temp^=bit;
-		}
-		for(temp=0;temp<(((U64)(1))<<numsquares);temp++)
-		{
-			U64 tempocc=initmagicmoves_occ(squares,numsquares,temp);
-			#ifndef PERFECT_MAGIC_HASH
-				RmagicNOMASK2(i,tempocc)=initmagicmoves_Rmoves(i,tempocc);
-			#else
-				U64 moves=initmagicmoves_Rmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_r_magics[i])>>MINIMAL_R_BITS_SHIFT);
-				int j;
-				for(j=0;j<4900;j++)
-				{
-					if(!magicmovesrdb[j])
-					{
-						magicmovesrdb[j]=moves;
-						magicmoves_r_indices[i][index]=j;
-						break;
-					}
-					else if(magicmovesrdb[j]==moves)
-					{
-						magicmoves_r_indices[i][index]=j;
-						break;
-					}
-				}
-			#endif
-		}
-	}
+		magicmoves_copy(db,magicmoves_offset(false,square),magicmoves_b_database<square>)...,
+		magicmoves_copy(db,magicmoves_offset(true,square),magicmoves_r_database<square>)...
+	};
+	(void)copied;
+	return db;
 }
 
-void initMagics()
+alignas(64) static constexpr magicmoves_database magicmovesdb=magicmoves_build(std::make_index_sequence<64>());
+
+template<std::size_t... square>
+static constexpr magicmoves_entries magicmoves_build_entries(const bool rook, std::index_sequence<square...>)
 {
-    initmagicmoves();
-}
\ No newline at end of file
+	return {{{
+		rook ? magicmoves_r_mask[square] : magicmoves_b_mask[square],
+		rook ? magicmoves_r_magics[square] : magicmoves_b_magics[square],
+		magicmovesdb.moves+magicmoves_offset(rook,square),
+		rook ? magicmoves_r_shift[square] : magicmoves_b_shift[square]
+	}...}};
+}
+
+alignas(64) constexpr magicmoves_entries magicmoves_b_entries=magicmoves_build_entries(false,std::make_index_sequence<64>());
+alignas(64) constexpr magicmoves_entries magicmoves_r_entries=magicmoves_build_entries(true,std::make_index_sequence<64>());
@@ -5,20 +5,17 @@
  *need this functionality.
  *
  *Usage:
- *You must first initialize the generator with a call to initmagicmoves().
- *Then you can use the following macros for generating move bitboards by
+ *The move databases are generated at compile time, so there is nothing to
+ *initialize (altered from the original, which required initmagicmoves()).
+ *You can use the following macros for generating move bitboards by
  *giving them a square and an occupancy.  The macro will then "return"
  *the correct move bitboard for that particular square and occupancy. It
  *has been named Rmagic and Bmagic so that it will not conflict with
  *any functions/macros in your chess program called Rmoves/Bmoves. You
- *can macro Bmagic/Rmagic to Bmoves/Rmoves if you wish.  If you want to
- *minimize the size of the bitboards, make MINIMIZE_MAGIC uncommented in this
- *header (more info on this later).  Where you typedef your unsigned 64-bit
- *integer declare __64_BIT_INTEGER_DEFINED__.  If USE_INLINING is uncommented,
- *the macros will be expressed as MMINLINEd functions.  If PERFECT_MAGIC_HASH is
- *uncomment, the move generator will use an additional indrection to make the
- *table sizes smaller : (~50kb+((original size)/sizeof(PERFECT_MAGIC_HASH)).
- *The size listed from here on out are the sizes without PERFECT_MAGIC_HASH.
+ *can macro Bmagic/Rmagic to Bmoves/Rmoves if you wish.  Where you typedef
+ *your unsigned 64-bit integer declare __64_BIT_INTEGER_DEFINED__.  If
+ *USE_INLINING is uncommented, the macros will be expressed as MMINLINEd
+ *functions.
  *
  *Bmagic(square, occupancy)
  *Rmagic(square, occupancy)
@@ -42,16 +39,10 @@
  *Edit the beginning lines of this header for the defenition of a 64 bit
  *integer if necessary.
  *
- *If MINIMIZE_MAGIC is defined before including this file:
- *The move bitboard generator will use up 841kb of memory.
- *41kb of memory is used for the bishop database and 800kb is used for the rook
- *database.  If you feel the 800kb rook database is too big, then comment it out
- *and use a more traditional move bitboard generator in conjunction with the
- *magic move bitboard generator for bishops.
- *
- *If MINIMIAZE_MAGIC is not defined before including this file:
- *The move bitboard generator will use up 2304kb of memory but might perform a bit
- *faster.
+ *The move bitboard generator uses 793kb of memory, 41kb for the bishops and
+ *752kb for the rooks (altered from the original, which also offered a
+ *2304kb layout and a perfect hash layout, and padded the rook database to
+ *800kb).
  *
  *Copyright (C) 2007 Pradyumna Kannan.
  *
@@ -76,15 +67,6 @@
 #define _magicmovesh
 
 /*********MODIFY THE FOLLOWING IF NECESSARY********/
-//the default configuration is the best
-
-//Uncommont either one of the following or none
-#define MINIMIZE_MAGIC
-//#define PERFECT_MAGIC_HASH unsigned short
-
-//the following works only for perfect magic hash or no defenitions above
-//it uses variable shift for each square
-//#define VARIABLE_SHIFT
 
 #define USE_INLINING /*the MMINLINE keyword is assumed to be available*/
 
@@ -124,110 +106,53 @@ extern const U64 magicmoves_b_mask[64];
 extern const unsigned int magicmoves_b_shift[64];
 extern const unsigned int magicmoves_r_shift[64];
 
-#ifndef VARIABLE_SHIFT
-	#define MINIMAL_B_BITS_SHIFT(square) 55
-	#define MINIMAL_R_BITS_SHIFT(square) 52
-#else
-	#define MINIMAL_B_BITS_SHIFT(square) magicmoves_b_shift[square]
-	#define MINIMAL_R_BITS_SHIFT(square) magicmoves_r_shift[square]
-#endif
-
-#ifndef PERFECT_MAGIC_HASH
-	#ifdef MINIMIZE_MAGIC
-
-		#ifndef USE_INLINING
-			#define Bmagic(square, occupancy) *(magicmoves_b_indices[square]+((((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
-			#define Rmagic(square, occupancy) *(magicmoves_r_indices[square]+((((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
-			#define BmagicNOMASK(square, occupancy) *(magicmoves_b_indices[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
-			#define RmagicNOMASK(square, occupancy) *(magicmoves_r_indices[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
-		#endif //USE_INLINING
-
-		//extern U64 magicmovesbdb[5248];
-		extern const U64* magicmoves_b_indices[64];
-
-		//extern U64 magicmovesrdb[102400];
-		extern const U64* magicmoves_r_indices[64];
-
-	#else //Don't Minimize database size
-
-		#ifndef USE_INLINING
-			#define Bmagic(square, occupancy) magicmovesbdb[square][(((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]
-			#define Rmagic(square, occupancy) magicmovesrdb[square][(((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]
-			#define BmagicNOMASK(square, occupancy) magicmovesbdb[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]
-			#define RmagicNOMASK(square, occupancy) magicmovesrdb[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]
-		#endif //USE_INLINING
-
-		extern U64 magicmovesbdb[64][1<<9];
-		extern U64 magicmovesrdb[64][1<<12];
-
-	#endif //MINIMIAZE_MAGICMOVES
-#else //PERFCT_MAGIC_HASH defined
-	#ifndef MINIMIZE_MAGIC
-
-		#ifndef USE_INLINING
-			#define Bmagic(square, occupancy) magicmovesbdb[magicmoves_b_indices[square][(((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]]
-			#define Rmagic(square, occupancy) magicmovesrdb[magicmoves_r_indices[square][(((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]]
-			#define BmagicNOMASK(square, occupancy) magicmovesbdb[magicmoves_b_indices[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]]
-			#define RmagicNOMASK(square, occupancy) magicmovesrdb[magicmoves_r_indices[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]]
-		#endif //USE_INLINING
-
-		extern U64 magicmovesbdb[1428];
-		extern U64 magicmovesrdb[4900];
-		extern PERFECT_MAGIC_HASH magicmoves_b_indices[64][1<<9];
-		extern PERFECT_MAGIC_HASH magicmoves_r_indices[64][1<<12];
-	#else
-		#error magicmoves - MINIMIZED_MAGIC and PERFECT_MAGIC_HASH cannot be used together
-	#endif
-#endif //PERFCT_MAGIC_HASH
+/*Altered from the original: only the minimized, variable shift layout is
+ *built. Everything a lookup needs for one square is kept together in one
+ *entry, two entries to a cache line, and the moves of every square of both
+ *pieces are in one contiguous, cache line aligned database.*/
+typedef struct
+{
+	U64 mask;
+	U64 magic;
+	const U64* moves;
+	unsigned int shift;
+} magicmoves_entry;
+
+typedef struct
+{
+	magicmoves_entry square[64];
+} magicmoves_entries;
+
+extern const magicmoves_entries magicmoves_b_entries;
+extern const magicmoves_entries magicmoves_r_entries;
+
+#ifndef USE_INLINING
+	#define Bmagic(square, occupancy) magicmoves_b_entries.square[square].moves[(((occupancy)&magicmoves_b_entries.square[square].mask)*magicmoves_b_entries.square[square].magic)>>magicmoves_b_entries.square[square].shift]
+	#define Rmagic(square, occupancy) magicmoves_r_entries.square[square].moves[(((occupancy)&magicmoves_r_entries.square[square].mask)*magicmoves_r_entries.square[square].magic)>>magicmoves_r_entries.square[square].shift]
+	#define BmagicNOMASK(square, occupancy) magicmoves_b_entries.square[square].moves[((occupancy)*magicmoves_b_entries.square[square].magic)>>magicmoves_b_entries.square[square].shift]
+	#define RmagicNOMASK(square, occupancy) magicmoves_r_entries.square[square].moves[((occupancy)*magicmoves_r_entries.square[square].magic)>>magicmoves_r_entries.square[square].shift]
+#endif //USE_INLINING
 
 #ifdef USE_INLINING
 	static MMINLINE U64 Bmagic(const unsigned int square,const U64 occupancy)
 	{
-		#ifndef PERFECT_MAGIC_HASH
-			#ifdef MINIMIZE_MAGIC
-				return *(magicmoves_b_indices[square]+(((occupancy&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>magicmoves_b_shift[square]));
-			#else
-				return magicmovesbdb[square][(((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)];
-			#endif
-		#else
-			return magicmovesbdb[magicmoves_b_indices[square][(((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]];
-		#endif
+		const magicmoves_entry* e=&magicmoves_b_entries.square[square];
+		return e->moves[((occupancy&e->mask)*e->magic)>>e->shift];
 	}
 	static MMINLINE U64 Rmagic(const unsigned int square,const U64 occupancy)
 	{
-		#ifndef PERFECT_MAGIC_HASH
-			#ifdef MINIMIZE_MAGIC
-				return *(magicmoves_r_indices[square]+(((occupancy&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>magicmoves_r_shift[square]));
-			#else
-				return magicmovesrdb[square][(((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)];
-			#endif
-		#else
-			return magicmovesrdb[magicmoves_r_indices[square][(((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]];
-		#endif
+		const magicmoves_entry* e=&magicmoves_r_entries.square[square];
+		return e->moves[((occupancy&e->mask)*e->magic)>>e->shift];
 	}
 	static MMINLINE U64 BmagicNOMASK(const unsigned int square,const U64 occupancy)
 	{
-		#ifndef PERFECT_MAGIC_HASH
-			#ifdef MINIMIZE_MAGIC
-				return *(magicmoves_b_indices[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]));
-			#else
-				return magicmovesbdb[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)];
-			#endif
-		#else
-			return magicmovesbdb[magicmoves_b_indices[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]];
-		#endif
+		const magicmoves_entry* e=&magicmoves_b_entries.square[square];
+		return e->moves[(occupancy*e->magic)>>e->shift];
 	}
 	static MMINLINE U64 RmagicNOMASK(const unsigned int square, const U64 occupancy)
 	{
-		#ifndef PERFECT_MAGIC_HASH
-			#ifdef MINIMIZE_MAGIC
-				return *(magicmoves_r_indices[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]));
-			#else
-				return magicmovesrdb[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)];
-			#endif
-		#else
-			return magicmovesrdb[magicmoves_r_indices[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]];
-		#endif
+		const magicmoves_entry* e=&magicmoves_r_entries.square[square];
+		return e->moves[(occupancy*e->magic)>>e->shift];
 	}
 
 	static MMINLINE U64 Qmagic(const unsigned int square,const U64 occupancy)
@@ -245,6 +170,4 @@ extern const unsigned int magicmoves_r_shift[64];
 
 #endif //USE_INLINING
 
-void initmagicmoves(void);
-
 #endif //_magicmoveshvesh
@@ -0,0 +1,118 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include "test.h"
+
+#if defined(COUNT_ALLOCATIONS)
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// In a build with COUNT_ALLOCATIONS defined (make allocs), every operator    //
+// new in the engine adds to allocations, so a bench can tell how many        //
+// heap allocations the code it runs has made. Every replaceable form is      //
+// replaced, the aligned ones too, since SearchThread and State are over      //
+// aligned. Normal builds keep the library allocator.                         //
+//                                                                            //
+// These live in their own file so they are never inlined into the code that  //
+// allocates, where the compiler would see free() on memory from new.         //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+static std::atomic<uint64_t> allocations(0);
+
+uint64_t allocationCount()
+{
+	return allocations;
+}
+
+static void* allocate(std::size_t size, std::size_t align)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (align <= alignof(std::max_align_t))
+		return std::malloc(size ? size : 1);
+
+	// Over allocate, and keep the pointer malloc returned just in front of
+	// the aligned block for release to find.
+	void* raw = std::malloc(size + align + sizeof(void*));
+	if (!raw)
+		return nullptr;
+	std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + align - 1)
+	                 & ~(static_cast<std::uintptr_t>(align) - 1);
+	reinterpret_cast<void**>(p)[-1] = raw;
+	return reinterpret_cast<void*>(p);
+}
+
+static void release(void* p, std::size_t align)
+{
+	if (p && align > alignof(std::max_align_t))
+		p = static_cast<void**>(p)[-1];
+	std::free(p);
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = allocate(size, 0))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+	if (void* p = allocate(size, static_cast<std::size_t>(align)))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	return allocate(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	return allocate(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p) noexcept { release(p, 0); }
+void operator delete[](void* p) noexcept { release(p, 0); }
+void operator delete(void* p, std::size_t) noexcept { release(p, 0); }
+void operator delete[](void* p, std::size_t) noexcept { release(p, 0); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p, 0); }
+
+void operator delete(void* p, std::align_val_t align) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::align_val_t align) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	release(p, static_cast<std::size_t>(align));
+}
+#endif
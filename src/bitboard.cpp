@@ -1,21 +1,11 @@
+#include <utility>
 #include "bitboard.h"
 
-U64 square_bb[Board_size];
-U64 file_bb[Board_size];
-U64 rank_bb[Board_size];
-U64 pawn_attacks[Player_size][Board_size];
-U64 pawn_push[Player_size][Board_size];
-U64 pawn_dbl_push[Player_size][Board_size];
-U64 between_dia[Board_size][Board_size];
-U64 between_hor[Board_size][Board_size];
-U64 between[Board_size][Board_size];
-U64 coplanar[Board_size][Board_size];
-U64 adj_files[Board_size];
-U64 in_front[Player_size][Board_size];
-U64 king_net_bb[Player_size][Board_size];
-U64 outpost_area[Player_size];
-
-const U64 Knight_moves[Board_size] =
+#if defined(__GNUC__) && defined(__x86_64__)
+    #include <cpuid.h>
+#endif
+
+constexpr U64 Knight_moves[Board_size] =
 {
     U64(0x0000000000020400), U64(0x0000000000050800), U64(0x00000000000A1100), U64(0x0000000000142200),
     U64(0x0000000000284400), U64(0x0000000000508800), U64(0x0000000000A01000), U64(0x0000000000402000),
@@ -35,7 +25,7 @@ const U64 Knight_moves[Board_size] =
     U64(0x0044280000000000), U64(0x0088500000000000), U64(0x0010A00000000000), U64(0x0020400000000000)
 };
 
-const U64 King_moves[Board_size] =
+constexpr U64 King_moves[Board_size] =
 {
     U64(0x0000000000000302), U64(0x0000000000000705), U64(0x0000000000000E0A), U64(0x0000000000001C14),
     U64(0x0000000000003828), U64(0x0000000000007050), U64(0x000000000000E0A0), U64(0x000000000000C040),
@@ -55,89 +45,335 @@ const U64 King_moves[Board_size] =
     U64(0x2838000000000000), U64(0x5070000000000000), U64(0xA0E0000000000000), U64(0x40C0000000000000)
 };
 
-U64 bishopMoves[Board_size];
-U64 rookMoves[Board_size];
+namespace
+{
 
-void bb_init()
+// Attacks along one ray from s, stopping at the first occupied square. The
+// mask keeps the shift from wrapping around the edge of the board.
+constexpr U64 ray_attacks(int s, U64 occ, int shift, U64 mask)
 {
-    for (Square sq_src = first_sq; sq_src <= last_sq; ++sq_src)
+    U64 attacks = 0;
+    U64 bit = 1ULL << s;
+    do
     {
-        U64 bit = 1ULL << sq_src;
-        square_bb[sq_src] = bit;
-        pawn_attacks[white][sq_src] = ((bit & Not_h_file) << 7)
-                                    | ((bit & Not_a_file) << 9);
-        pawn_attacks[black][sq_src] = ((bit & Not_h_file) >> 9)
-                                    | ((bit & Not_a_file) >> 7);
-        pawn_push[white][sq_src]    = bit << 8;
-        pawn_push[black][sq_src]    = bit >> 8;
+        bit = shift > 0 ? (bit & mask) << shift : (bit & mask) >> -shift;
+        attacks |= bit;
+    } while (bit && !(bit & occ));
+    return attacks;
+}
 
-        U64 front = east_fill(bit) | west_fill(bit);
-        in_front[white][sq_src] = north_fill(front << 8);
-        in_front[black][sq_src] = south_fill(front >> 8);
+constexpr U64 rook_rays(int s, U64 occ)
+{
+    return ray_attacks(s, occ,  8, ~0ULL)
+         | ray_attacks(s, occ, -8, ~0ULL)
+         | ray_attacks(s, occ,  1, Not_a_file)
+         | ray_attacks(s, occ, -1, Not_h_file);
+}
 
-        king_net_bb[white][sq_src] = King_moves[sq_src] | (King_moves[sq_src] << 16);
-        king_net_bb[black][sq_src] = King_moves[sq_src] | (King_moves[sq_src] >> 16);
+constexpr U64 bishop_rays(int s, U64 occ)
+{
+    return ray_attacks(s, occ,  7, Not_h_file)
+         | ray_attacks(s, occ,  9, Not_a_file)
+         | ray_attacks(s, occ, -7, Not_a_file)
+         | ray_attacks(s, occ, -9, Not_h_file);
+}
+
+constexpr SquareTable make_square_bb()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+        t[s] = 1ULL << s;
+    return t;
+}
+
+constexpr SquareTable make_file_bb()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+        t[s] = north_fill(1ULL << s) | south_fill(1ULL << s);
+    return t;
+}
 
-        file_bb[sq_src] = north_fill(bit) | south_fill(bit);
-        rank_bb[sq_src] = east_fill(bit) | west_fill(bit);
+constexpr SquareTable make_rank_bb()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+        t[s] = east_fill(1ULL << s) | west_fill(1ULL << s);
+    return t;
+}
 
-        bishopMoves[sq_src] = (north_east_fill(bit) | north_west_fill(bit) 
-                    | south_east_fill(bit) | south_west_fill(bit)) & ~bit;
+constexpr ColorSquareTable make_pawn_attacks()
+{
+    ColorSquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        U64 bit = 1ULL << s;
+        t[white][s] = ((bit & Not_h_file) << 7) | ((bit & Not_a_file) << 9);
+        t[black][s] = ((bit & Not_h_file) >> 9) | ((bit & Not_a_file) >> 7);
+    }
+    return t;
+}
 
-        rookMoves[sq_src] = (north_fill(bit) | south_fill(bit) 
-                  | east_fill(bit) | west_fill(bit)) & ~bit;
+constexpr ColorSquareTable make_pawn_push()
+{
+    ColorSquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        t[white][s] = (1ULL << s) << 8;
+        t[black][s] = (1ULL << s) >> 8;
+    }
+    return t;
+}
 
-        if (bit & Rank_2)
-        {
-            pawn_dbl_push[white][sq_src] = bit << 16;
-            pawn_dbl_push[black][sq_src] = 0;
-        }
-        else if (bit & Rank_7)
+constexpr ColorSquareTable make_pawn_dbl_push()
+{
+    ColorSquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        U64 bit = 1ULL << s;
+        t[white][s] = bit & Rank_2 ? bit << 16 : 0;
+        t[black][s] = bit & Rank_7 ? bit >> 16 : 0;
+    }
+    return t;
+}
+
+// Squares strictly between two squares on a shared line, using sliding
+// attacks from both ends, or every square of the line for coplanar.
+constexpr SquarePairTable make_between(bool pRook, bool pBishop, bool pLine)
+{
+    SquarePairTable t{};
+    for (int src = first_sq; src <= last_sq; ++src)
+    {
+        for (int dst = first_sq; dst <= last_sq; ++dst)
         {
-            pawn_dbl_push[white][sq_src] = 0;
-            pawn_dbl_push[black][sq_src] = bit >> 16;
+            U64 occ = 1ULL << src | 1ULL << dst;
+            U64 block = pLine ? 0 : occ;
+            U64 r = rook_rays(src, block);
+            U64 b = bishop_rays(src, block);
+            r &= r & occ ? rook_rays(dst, block) : 0;
+            b &= b & occ ? bishop_rays(dst, block) : 0;
+            t[src][dst] = (pRook ? r : 0) | (pBishop ? b : 0);
         }
-        else
+    }
+    return t;
+}
+
+constexpr SquareTable make_adj_files()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        U64 bit = 1ULL << s;
+        t[s] = bit & File_a ? File_b
+             : bit & File_b ? File_a | File_c
+             : bit & File_c ? File_b | File_d
+             : bit & File_d ? File_c | File_e
+             : bit & File_e ? File_d | File_f
+             : bit & File_f ? File_e | File_g
+             : bit & File_g ? File_f | File_h
+             : File_g;
+    }
+    return t;
+}
+
+constexpr ColorSquareTable make_in_front()
+{
+    ColorSquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        U64 front = east_fill(1ULL << s) | west_fill(1ULL << s);
+        t[white][s] = north_fill(front << 8);
+        t[black][s] = south_fill(front >> 8);
+    }
+    return t;
+}
+
+constexpr ColorSquareTable make_king_net()
+{
+    ColorSquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+    {
+        t[white][s] = King_moves[s] | (King_moves[s] << 16);
+        t[black][s] = King_moves[s] | (King_moves[s] >> 16);
+    }
+    return t;
+}
+
+constexpr SquareTable make_bishop_moves()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+        t[s] = bishop_rays(s, 0);
+    return t;
+}
+
+constexpr SquareTable make_rook_moves()
+{
+    SquareTable t{};
+    for (int s = first_sq; s <= last_sq; ++s)
+        t[s] = rook_rays(s, 0);
+    return t;
+}
+
+constexpr int bit_count(U64 bb)
+{
+    int count = 0;
+    for (; bb; bb &= bb - 1)
+        ++count;
+    return count;
+}
+
+constexpr U64 bishop_mask(int s)
+{
+    return bishop_rays(s, 0) & ~(Rank_1 | Rank_8 | File_a | File_h);
+}
+
+constexpr U64 rook_mask(int s)
+{
+    return ((ray_attacks(s, 0, 8, ~0ULL) | ray_attacks(s, 0, -8, ~0ULL)) & ~(Rank_1 | Rank_8))
+         | ((ray_attacks(s, 0, 1, Not_a_file) | ray_attacks(s, 0, -1, Not_h_file)) & ~(File_a | File_h));
+}
+
+constexpr U64 slider_mask(int s, bool pRook)
+{
+    return pRook ? rook_mask(s) : bishop_mask(s);
+}
+
+// Attacks from one square for every subset of its mask, in PEXT order: bit i
+// of the index is the i-th lowest bit of the mask. Each square is its own
+// constant so no single compile time evaluation grows too large.
+template<int S, bool Rook>
+struct PextAttacks
+{
+    constexpr PextAttacks() : attacks{}
+    {
+        for (U64 index = 0; index < Size; ++index)
         {
-            pawn_dbl_push[white][sq_src] = 0;
-            pawn_dbl_push[black][sq_src] = 0;
+            U64 occ = 0;
+            U64 mask = slider_mask(S, Rook);
+            for (U64 bit = 1; mask; bit <<= 1, mask &= mask - 1)
+                if (index & bit)
+                    occ |= mask & (0 - mask);
+            attacks[index] = Rook ? rook_rays(S, occ) : bishop_rays(S, occ);
         }
-        for (Square sq_dst = H1; sq_dst <= A8; ++sq_dst)
-        {
-            adj_files[sq_dst] = sq_dst & File_a ? File_b
-                              : sq_dst & File_b ? File_a | File_c
-                              : sq_dst & File_c ? File_b | File_d
-                              : sq_dst & File_d ? File_c | File_e
-                              : sq_dst & File_e ? File_d | File_f
-                              : sq_dst & File_f ? File_e | File_g
-                              : sq_dst & File_g ? File_f | File_h
-                              : File_g;
+    }
+    static constexpr U64 Size = 1ULL << bit_count(slider_mask(S, Rook));
+    U64 attacks[Size];
+};
 
+template<int S, bool Rook>
+constexpr PextAttacks<S, Rook> pext_attacks{};
 
-            U64 r_attacks, b_attacks, occ;
-            occ = 1ULL << sq_src | 1ULL << sq_dst;
-            
-            r_attacks = Rmagic(sq_src, 0);
-            b_attacks = Bmagic(sq_src, 0);
+// Where each square's attacks start in the combined table: all the bishop
+// squares in order, then all the rook squares.
+constexpr std::size_t pext_offset(bool pRook, int s)
+{
+    std::size_t offset = 0;
+    for (int i = 0; i < (pRook ? Board_size : s); ++i)
+        offset += 1ULL << bit_count(bishop_mask(i));
+    for (int i = 0; pRook && i < s; ++i)
+        offset += 1ULL << bit_count(rook_mask(i));
+    return offset;
+}
 
-            r_attacks &= (r_attacks & occ ? Rmagic(sq_dst, 0) : 0);
-            b_attacks &= (b_attacks & occ ? Bmagic(sq_dst, 0) : 0);
+struct PextDatabase
+{
+    U64 attacks[pext_offset(true, Board_size)];
+};
 
-            coplanar[sq_src][sq_dst] = r_attacks | b_attacks;
+template<typename T>
+constexpr int copy_attacks(PextDatabase& db, std::size_t offset, const T& square)
+{
+    for (std::size_t i = 0; i < T::Size; ++i)
+        db.attacks[offset + i] = square.attacks[i];
+    return 0;
+}
 
-            r_attacks = Rmagic(sq_src, occ);
-            b_attacks = Bmagic(sq_src, occ);
+// The per square constants are only read here, at compile time, so only the
+// combined table ends up in the program.
+template<std::size_t... S>
+constexpr PextDatabase make_pext_database(std::index_sequence<S...>)
+{
+    PextDatabase db{};
+    const int copied[] =
+    {
+        copy_attacks(db, pext_offset(false, S), pext_attacks<S, false>)...,
+        copy_attacks(db, pext_offset(true, S), pext_attacks<S, true>)...
+    };
+    (void)copied;
+    return db;
+}
 
-            r_attacks &= (r_attacks & occ ? Rmagic(sq_dst, occ) : 0);
-            b_attacks &= (b_attacks & occ ? Bmagic(sq_dst, occ) : 0);
+alignas(64) constexpr PextDatabase pext_database =
+    make_pext_database(std::make_index_sequence<Board_size>());
 
-            between_dia[sq_src][sq_dst] = b_attacks;
-            between_hor[sq_src][sq_dst] = r_attacks;
-            between[sq_src][sq_dst] = b_attacks | r_attacks;
+template<bool Rook, std::size_t... S>
+constexpr LookupTable<Pext::Entry, Board_size> make_pext(std::index_sequence<S...>)
+{
+    return {{ { slider_mask(S, Rook), pext_database.attacks + pext_offset(Rook, S) }... }};
+}
+
+}
+
+constexpr SquareTable square_bb = make_square_bb();
+constexpr SquareTable file_bb = make_file_bb();
+constexpr SquareTable rank_bb = make_rank_bb();
+constexpr ColorSquareTable pawn_attacks = make_pawn_attacks();
+constexpr ColorSquareTable pawn_push = make_pawn_push();
+constexpr ColorSquareTable pawn_dbl_push = make_pawn_dbl_push();
+constexpr SquarePairTable between_dia = make_between(false, true, false);
+constexpr SquarePairTable between_hor = make_between(true, false, false);
+constexpr SquarePairTable between = make_between(true, true, false);
+constexpr SquarePairTable coplanar = make_between(true, true, true);
+constexpr SquareTable adj_files = make_adj_files();
+constexpr ColorSquareTable in_front = make_in_front();
+constexpr ColorSquareTable king_net_bb = make_king_net();
+constexpr LookupTable<U64, Player_size> outpost_area =
+{
+    { Rank_4 | Rank_5 | Rank_6 | Rank_7, Rank_2 | Rank_3 | Rank_4 | Rank_5 }
+};
+constexpr SquareTable bishopMoves = make_bishop_moves();
+constexpr SquareTable rookMoves = make_rook_moves();
+
+namespace Pext
+{
+    bool enabled = false;
+
+    alignas(64) constexpr LookupTable<Entry, Board_size> bishop =
+        make_pext<false>(std::make_index_sequence<Board_size>());
+    alignas(64) constexpr LookupTable<Entry, Board_size> rook =
+        make_pext<true>(std::make_index_sequence<Board_size>());
+
+    // Whether this cpu can run PEXT at all.
+    bool available()
+    {
+#if defined(__GNUC__) && defined(__x86_64__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2");
+#else
+        return false;
+#endif
+    }
+
+    void init()
+    {
+        enabled = available();
+#if defined(__GNUC__) && defined(__x86_64__)
+        unsigned eax, ebx, ecx, edx;
+        if (enabled && __builtin_cpu_is("amd") && __get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            unsigned family = (eax >> 8) & 0xF;
+            if (family == 0xF)
+                family += (eax >> 20) & 0xFF;
+            enabled = family >= 0x19;
         }
+#endif
+    }
+
+    const char* backend()
+    {
+        return enabled ? "pext" : "magic";
     }
-    outpost_area[white] = Rank_4 | Rank_5 | Rank_6 | Rank_7;
-    outpost_area[black] = Rank_2 | Rank_3 | Rank_4 | Rank_5;
 }
 
 void print_bb(U64 bb)
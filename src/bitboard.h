@@ -9,28 +9,48 @@
 #include <string>
 #include <iostream>
 #include <cmath>
+#include <cstddef>
 #include "types.h"
 #include "MagicMoves.hpp"
 
-extern U64 square_bb[Board_size];
-extern U64 file_bb[Board_size];
-extern U64 rank_bb[Board_size];
-extern U64 pawn_attacks[Player_size][Board_size];
-extern U64 pawn_push[Player_size][Board_size];
-extern U64 pawn_dbl_push[Player_size][Board_size];
-extern U64 between_dia[Board_size][Board_size];
-extern U64 between_hor[Board_size][Board_size];
-extern U64 between[Board_size][Board_size];
-extern U64 coplanar[Board_size][Board_size];
-extern U64 adj_files[Board_size];
-extern U64 in_front[Player_size][Board_size];
-extern U64 king_net_bb[Player_size][Board_size];
-extern U64 outpost_area[Player_size];
+#if defined(_MSC_VER)
+    #include <xmmintrin.h>
+#endif
+
+// A fixed size lookup table. Unlike a plain array it can be filled in and
+// returned by a constexpr function, so the tables below are built by the
+// compiler and end up in read-only data.
+template<typename T, std::size_t N>
+struct LookupTable
+{
+    constexpr T& operator[](std::size_t i) { return values[i]; }
+    constexpr const T& operator[](std::size_t i) const { return values[i]; }
+    T values[N];
+};
+
+typedef LookupTable<U64, Board_size> SquareTable;
+typedef LookupTable<SquareTable, Player_size> ColorSquareTable;
+typedef LookupTable<SquareTable, Board_size> SquarePairTable;
+
+extern const SquareTable square_bb;
+extern const SquareTable file_bb;
+extern const SquareTable rank_bb;
+extern const ColorSquareTable pawn_attacks;
+extern const ColorSquareTable pawn_push;
+extern const ColorSquareTable pawn_dbl_push;
+extern const SquarePairTable between_dia;
+extern const SquarePairTable between_hor;
+extern const SquarePairTable between;
+extern const SquarePairTable coplanar;
+extern const SquareTable adj_files;
+extern const ColorSquareTable in_front;
+extern const ColorSquareTable king_net_bb;
+extern const LookupTable<U64, Player_size> outpost_area;
 
 extern const U64 Knight_moves[Board_size];
 extern const U64 King_moves[Board_size];
-extern U64 bishopMoves[Board_size];
-extern U64 rookMoves[Board_size];
+extern const SquareTable bishopMoves;
+extern const SquareTable rookMoves;
 
 static const U64 Dark_squares  = 0xAA55AA55AA55AA55ULL;
 static const U64 Light_squares = 0x55AA55AA55AA55AAULL;
@@ -61,7 +81,65 @@ static const U64 Center_files = Not_a_file & Not_h_file;
 static const U64 Rightside = 0x0F0F0F0F0F0F0F0F;
 static const U64 Leftside = 0xF0F0F0F0F0F0F0F0;
 
-void bb_init();
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Sliding piece attacks. The magic tables from MagicMoves work on any cpu.   //
+// With BMI2 the relevant occupancy bits can instead be extracted straight    //
+// into a table index with PEXT, which saves the multiply and the shift. AMD  //
+// cpus before Zen 3 run PEXT in microcode and are much slower with it, so    //
+// Pext::init only turns it on where it is fast. The engine is built without  //
+// -mbmi2, so the instruction is written as inline assembly and only runs     //
+// once init has checked the cpu.                                             //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+namespace Pext
+{
+    struct Entry
+    {
+        U64 mask;              // Relevant occupancy, board edges excluded.
+        const U64* attacks;    // Indexed by the extracted occupancy bits.
+    };
+
+    extern bool enabled;
+    extern const LookupTable<Entry, Board_size> bishop;
+    extern const LookupTable<Entry, Board_size> rook;
+
+    void init();
+    bool available();
+    const char* backend();
+
+    inline U64 extract(U64 occ, U64 mask)
+    {
+#if defined(__GNUC__) && defined(__x86_64__)
+        U64 index;
+        asm("pextq %2, %1, %0" : "=r"(index) : "r"(occ), "rm"(mask));
+        return index;
+#else
+        U64 index = 0;
+        for (U64 bit = 1; mask; bit <<= 1, mask &= mask - 1)
+            if (occ & mask & (0 - mask))
+                index |= bit;
+        return index;
+#endif
+    }
+}
+
+inline U64 bishop_attacks(Square s, U64 occ)
+{
+    return Pext::enabled ? Pext::bishop[s].attacks[Pext::extract(occ, Pext::bishop[s].mask)]
+                         : Bmagic(s, occ);
+}
+
+inline U64 rook_attacks(Square s, U64 occ)
+{
+    return Pext::enabled ? Pext::rook[s].attacks[Pext::extract(occ, Pext::rook[s].mask)]
+                         : Rmagic(s, occ);
+}
+
+inline U64 queen_attacks(Square s, U64 occ)
+{
+    return bishop_attacks(s, occ) | rook_attacks(s, occ);
+}
 
 inline U64 operator&(Square s, U64 u)
 {
@@ -97,6 +175,16 @@ inline int pop_count(U64 bb)
 #endif
 }
 
+// Starts loading the cache line holding addr without waiting for it.
+inline void prefetch(const void* addr)
+{
+#if defined(_MSC_VER)
+   _mm_prefetch(static_cast<const char*>(addr), _MM_HINT_T0);
+#elif defined(__GNUC__)
+   __builtin_prefetch(addr);
+#endif
+}
+
 // Returns the index of the LSB.
 inline Square get_lsb(U64 bb)
 {
@@ -228,8 +316,8 @@ void move_bit(U64 & bb, int src, int dst)
 // Prints a bitboard for debugging purposes.
 void print_bb(U64);
 
-// Currently unused fill functions;
-inline
+// Fill functions, used to build the tables at compile time.
+constexpr
 U64 north_fill(U64 gen) 
 {
    gen |= (gen <<  8);
@@ -238,7 +326,7 @@ U64 north_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 south_fill(U64 gen) 
 {
    gen |= (gen >>  8);
@@ -247,7 +335,7 @@ U64 south_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 east_fill(U64 gen) 
 {
    const U64 pr0 = Not_h_file;
@@ -259,7 +347,7 @@ U64 east_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 north_east_fill(U64 gen) 
 {
    const U64 pr0 = Not_h_file;
@@ -271,7 +359,7 @@ U64 north_east_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 south_east_fill(U64 gen) 
 {
    const U64 pr0 = Not_h_file;
@@ -283,7 +371,7 @@ U64 south_east_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 west_fill(U64 gen) 
 {
    const U64 pr0 = Not_a_file;
@@ -295,7 +383,7 @@ U64 west_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 south_west_fill(U64 gen) 
 {
    const U64 pr0 = Not_a_file;
@@ -307,7 +395,7 @@ U64 south_west_fill(U64 gen)
    return gen;
 }
 
-inline
+constexpr
 U64 north_west_fill(U64 gen) 
 {
    const U64 pr0 = Not_a_file;
@@ -0,0 +1,62 @@
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "types.h"
+
+const int Eval_cache_size = 1 << 17;             // Entries, 1 MiB.
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A direct mapped cache of final static evaluations, one per search thread.  //
+// Each slot is a single word: the top 48 bits of the position key with the   //
+// score in the low 16 bits. The low bits of the key pick the slot, so the    //
+// two together identify the position.                                        //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+class EvalCache
+{
+public:
+    EvalCache()
+    : mTable(Eval_cache_size), mProbes(0), mHits(0)
+    {}
+    bool probe(U64 key, int& score)
+    {
+        const U64 entry = mTable[key & (Eval_cache_size - 1)];
+        ++mProbes;
+        if ((entry ^ key) >> 16)
+            return false;
+        ++mHits;
+        score = static_cast<int16_t>(entry & 0xFFFF);
+        return true;
+    }
+    void store(U64 key, int score)
+    {
+        score = std::max(INT16_MIN, std::min(score, static_cast<int>(INT16_MAX)));
+        mTable[key & (Eval_cache_size - 1)] = (key & ~0xFFFFull) | static_cast<uint16_t>(score);
+    }
+    void clear()
+    {
+        std::fill(mTable.begin(), mTable.end(), 0);
+        clearStats();
+    }
+    void clearStats()
+    {
+        mProbes = mHits = 0;
+    }
+    uint64_t getProbes() const
+    {
+        return mProbes;
+    }
+    uint64_t getHits() const
+    {
+        return mHits;
+    }
+private:
+    std::vector<U64> mTable;
+    uint64_t mProbes, mHits;
+};
+
+#endif
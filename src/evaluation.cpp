@@ -6,9 +6,14 @@
 // calculate the score in centipawns from the perspective of the side to      //
 // move.                                                                      //
 //                                                                            //
+// Given a search window, the evaluation may stop early once the score is     //
+// known to fall outside of it (see isLazy).                                  //
+//                                                                            //
 // -------------------------------------------------------------------------- //
-Evaluate::Evaluate(const State& pState)
+Evaluate::Evaluate(const State& pState, PawnHash& pPawnHash, const MaterialEntry& pMaterial,
+                   int pAlpha, int pBeta)
 : mState(pState)
+, mLazy(false)
 , mMaterial{}
 , mPawnStructure{}
 , mMobility{}
@@ -20,87 +25,116 @@ Evaluate::Evaluate(const State& pState)
 
 // -------------------------------------------------------------------------- //
 //                                                                            //
-// If any pawns are on the board, check if there is a valid entry in the      //
-// pawn hash table. The pawn key for the current state is used to check if    //
-// the value in the hash table matches the current state. If a pawn is        //
-// neither moved or captured, we can use some of the same evaluation          //
-// information. If a valid is found, we can use calculations for:             //
-//   1. Pawn Structure                                                        //
-//   2. Pawn Material                                                         //
+// Check if there is a valid entry in the pawn hash table. The pawn key for   //
+// the current state is used to check if the value in the hash table matches  //
+// the current state. If a pawn is neither moved or captured, we can use all  //
+// of the pawn information in the entry (see PawnEntry).                      //
+//                                                                            //
+// A position without pawns has a pawn key of 0, the same as an empty slot,   //
+// so it is always evaluated.                                                 //
 //                                                                            //
 // -------------------------------------------------------------------------- //
-    if (mState.getPieceCount<pawn>())
+    const U64 pawnKey = mState.getPawnKey();
+    PawnEntry* pawnEntry = pPawnHash.probe(pawnKey);
+    if (pawnEntry->getKey() != pawnKey || !pawnKey)
     {
-        const PawnEntry* pawnEntry = probe(mState.getPawnKey());
-        if (pawnEntry && pawnEntry->getKey() == mState.getPawnKey())
-        {
-            mPawnStructure = pawnEntry->getStructure();
-            mMaterial = pawnEntry->getMaterial();
-        }
-        else
-        {
 // -------------------------------------------------------------------------- //
 //                                                                            //
 // If no pawn entry is found in the hash table, evaluate pawns for both       // 
 // players and store the result as a new entry in the hash table.             //
 //                                                                            //
 // -------------------------------------------------------------------------- //
-            evalPawns(white);
-            evalPawns(black);
-            store(mState.getPawnKey(), mPawnStructure, mMaterial);
-        }
+        *pawnEntry = PawnEntry();
+        pawnEntry->mKey = pawnKey;
+        evalPawns(white, *pawnEntry);
+        evalPawns(black, *pawnEntry);
     }
+    mPawns = pawnEntry;
+    mPawnStructure = mPawns->getStructure();
+    mMaterial = mPawns->getMaterial();
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Piece weights and imbalance terms only depend on the piece counts, so they //
+// come from the material table.                                              //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    for (Color c : { white, black })
+        mMaterial[c] += pMaterial.mMaterial[c] + pMaterial.mImbalance[c];
 
 // -------------------------------------------------------------------------- //
 //                                                                            //
 // For evaluation concepts that have different weights for mid-game and       //
 // end-game (such as PST), a game phase is used to interpolate these values   //
 // and avoid any evaluation discontinuity. This is also known as a tapered    //
-// evaluation. The game phase is between 0 - 255, closer to 0 puts more       //
-// weight on the mid-game, closer to 255 puts more weight on the endgame.     //
+// evaluation. The game phase is between 0 - 256, closer to 0 puts more       //
+// weight on the mid-game, closer to 256 puts more weight on the endgame. The //
+// PST is kept as a packed Score, so tapering it is a single taper call.      //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    mGamePhase = pMaterial.mPhase;
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Score the cheap terms first: material, pawn structure, the tapered PST     //
+// and tempo. Tempo is added to the score to give the side to move a slight   //
+// advantage.                                                                 //
 //                                                                            //
 // -------------------------------------------------------------------------- //
-    mGamePhase = mState.getGamePhase();
+    Color c = mState.getOurColor();
+    const int base = mPawnStructure[c] - mPawnStructure[!c]
+                   + mMaterial[c]      - mMaterial[!c];
+    const int pst = taper(mState.getPstScore(), mGamePhase);
+
+    mScore = base + pst + tempo;
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Lazy evaluation. Mobility, king safety and attacks are the expensive part  //
+// of the evaluation. If the score so far is more than Lazy_margin outside    //
+// the window they can't bring it back, so skip them. The score is moved by   //
+// the margin towards the window, which keeps it a bound on the full score    //
+// that is still outside the window.                                          //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    if (mScore + Lazy_margin <= pAlpha)
+    {
+        mScore += Lazy_margin;
+        mLazy = true;
+        return;
+    }
+    if (mScore - Lazy_margin >= pBeta)
+    {
+        mScore -= Lazy_margin;
+        mLazy = true;
+        return;
+    }
 
     evalPieces(white);
     evalPieces(black);
 
 // -------------------------------------------------------------------------- //
 //                                                                            //
-// Add pawn attacks to the attacks bitboards. These can't be stored in the    //
-// pawn hash, since the same configuration of pawns could give different      //
-// attack sets depening on the location of non-pawn pieces.                   //
+// Add pawn attacks to the attacks bitboards. Only the squares pawns attack   //
+// come from the pawn hash, which of them hold pieces depends on the location //
+// of non-pawn pieces.                                                        //
 //                                                                            //
 // -------------------------------------------------------------------------- //
-    mPieceAttacksBB[white][pawn] |= (mState.getPieceBB<pawn>(white) & Not_a_file) << 9
-        & mState.getOccupancyBB();
-    mPieceAttacksBB[white][pawn] |= (mState.getPieceBB<pawn>(white) & Not_h_file) << 7
-        & mState.getOccupancyBB();
-    mPieceAttacksBB[black][pawn] |= (mState.getPieceBB<pawn>(black) & Not_a_file) >> 7
-        & mState.getOccupancyBB();
-    mPieceAttacksBB[black][pawn] |= (mState.getPieceBB<pawn>(black) & Not_h_file) >> 9
-        & mState.getOccupancyBB();
+    mPieceAttacksBB[white][pawn] |= mPawns->getAttacks(white) & mState.getOccupancyBB();
+    mPieceAttacksBB[black][pawn] |= mPawns->getAttacks(black) & mState.getOccupancyBB();
     mAllAttacksBB[white] |= mPieceAttacksBB[white][pawn];
     mAllAttacksBB[black] |= mPieceAttacksBB[black][pawn];
 
     evalAttacks(white);
     evalAttacks(black);
 
-    Color c = mState.getOurColor();
+    // evalPieces added the outpost, bishop and trapped rook terms to the
+    // material, so base is out of date.
     mScore = mMobility[c]      - mMobility[!c]
           + mKingSafety[c]    - mKingSafety[!c]
           + mPawnStructure[c] - mPawnStructure[!c]
-          + mMaterial[c]      - mMaterial[!c];
-
-    mScore += ((mState.getPstScore(middle) * (256 - mGamePhase))
-           + mState.getPstScore(late) * mGamePhase) / 256;
-
-// -------------------------------------------------------------------------- //
-//                                                                            //
-// Tempo is added to the score to give the side to move a slight advantage.   //
-//                                                                            //
-// -------------------------------------------------------------------------- //
-    mScore += tempo;
+          + mMaterial[c]      - mMaterial[!c]
+          + pst + tempo;
 }
 
 int Evaluate::getScore() const
@@ -108,6 +142,12 @@ int Evaluate::getScore() const
     return mScore;
 }
 
+// True if the evaluation stopped early. The score is then only a bound.
+bool Evaluate::isLazy() const
+{
+    return mLazy;
+}
+
 template<PieceType PT>
 int Evaluate::outpost(Square p, Color c)
 {
@@ -115,8 +155,8 @@ int Evaluate::outpost(Square p, Color c)
     // To be an outpost, the piece must be supported by a friendly pawn
     // and unable to be attacked by an opponents pawn.
     if (   !(p & outpost_area[c])
-        || !(pawn_attacks[!c][p] & mState.getPieceBB<pawn>(c))
-        || in_front[c][p] & adj_files[p] & mState.getPieceBB<pawn>(!c))
+        || !(p & mPawns->getAttacks(c))
+        || p & mPawns->getAttackSpan(!c))
         return 0;
 
     score = PieceSquareTable::outpost[PT == bishop][c][p];
@@ -129,9 +169,16 @@ int Evaluate::outpost(Square p, Color c)
     return score;
 }
 
-void Evaluate::evalPawns(const Color c)
+void Evaluate::evalPawns(const Color c, PawnEntry& e)
 {
     const int dir = c == white ? 8 : -8;
+    const U64 pawns = mState.getPieceBB<pawn>(c);
+
+    if (c == white)
+        e.mAttacks[c] = (pawns & Not_a_file) << 9 | (pawns & Not_h_file) << 7;
+    else
+        e.mAttacks[c] = (pawns & Not_a_file) >> 7 | (pawns & Not_h_file) >> 9;
+    e.mSemiOpen[c] = 0xFF;
 
     // Pawn evaluation.
     for (Square p : mState.getPieceList<pawn>(c))
@@ -139,10 +186,16 @@ void Evaluate::evalPawns(const Color c)
         if (p == no_sq)
             break;
 
-        mMaterial[c] += Pawn_wt;
+        e.mAttackSpan[c] |= in_front[c][p] & adj_files[p];
+        e.mSemiOpen[c] &= ~(1 << file(p));
+
+        e.mMaterial[c] += Pawn_wt;
         // Check if the pawn is a passed pawn.
         if (!((file_bb[p] | adj_files[p]) & in_front[c][p] & mState.getPieceBB<pawn>(!c)))
-            mPawnStructure[c] += Passed;
+        {
+            e.mPassed[c] |= square_bb[p];
+            e.mStructure[c] += Passed;
+        }
         // Look for candidate and backwards pawns since the logic is related.
         // First check for a half open file.
         else if (!(file_bb[p] & in_front[c][p] & mState.getPieceBB<pawn>(!c)))
@@ -160,7 +213,7 @@ void Evaluate::evalPawns(const Color c)
                 // If there are more helpers then sentries, we have a candidate
                 // passer.
                 if (helpers >= sentries)
-                    mPawnStructure[c] += Candidate;
+                    e.mStructure[c] += Candidate;
                 // If there are less helpers then sentries, check for a backwards
                 // pawn. First, see if there are no pawns eligible to defend it.
                 else if (!(~in_front[c][p] & adj_files[p] & mState.getPieceBB<pawn>(c)))
@@ -171,9 +224,9 @@ void Evaluate::evalPawns(const Color c)
                         // If there are two sentries, this backwards pawn is
                         // nearly imposible to push.
                         if (sentries == 2)
-                            mPawnStructure[c] += Full_backwards;
+                            e.mStructure[c] += Full_backwards;
                         else
-                            mPawnStructure[c] += Backwards;
+                            e.mStructure[c] += Backwards;
                     }
                 }
             }
@@ -181,14 +234,46 @@ void Evaluate::evalPawns(const Color c)
 
         // Check if the pawn is isolated
         if (!(adj_files[p] & mState.getPieceBB<pawn>(c)))
-            mPawnStructure[c] += Isolated;
+            e.mStructure[c] += Isolated;
         // Check if the pawn is connected
         else if (rank_bb[p - dir] & mState.getPieceBB<pawn>(c) & adj_files[p])
-            mPawnStructure[c] += Connected;
+            e.mStructure[c] += Connected;
 
         // Check if the pawn is doubled.
         if (pop_count(file_bb[p] & mState.getPieceBB<pawn>(c)) > 1)
-            mPawnStructure[c] += Doubled;
+            e.mStructure[c] += Doubled;
+    }
+
+    evalShelter(c, e);
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Pawn shelter for a king on each file, from the king's own and adjacent     //
+// files. A pawn still on its second rank is the best cover, one step up is   //
+// still useful, anything further or no pawn at all is a hole. Only cached    //
+// for now, king safety doesn't score it until the weights are tested.        //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void Evaluate::evalShelter(const Color c, PawnEntry& e)
+{
+    const U64 pawns = mState.getPieceBB<pawn>(c);
+    const U64 near = c == white ? Rank_2 : Rank_7;
+    const U64 far  = c == white ? Rank_3 : Rank_6;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const Square k = static_cast<Square>(i);
+        int shelter = 0;
+        for (U64 files = file_bb[k] | adj_files[k]; files; )
+        {
+            U64 f = file_bb[pop_lsb(files)];
+            files &= ~f;
+            shelter += pawns & f & near ? ShelterNear
+                     : pawns & f & far  ? ShelterFar
+                     : ShelterNone;
+        }
+        e.mShelter[c][file(k)] = shelter;
     }
 }
 
@@ -201,13 +286,7 @@ void Evaluate::evalPieces(const Color c)
     Square kingSq = mState.getKingSquare(c);
 
     // The mobilityNet is all empty squares not attacked by enemy pawns.
-    mobilityNet = mState.getEmptyBB();
-    if (c == white)
-        mobilityNet &= ~((mState.getPieceBB<pawn>(black) & Not_a_file) >> 7
-                       | (mState.getPieceBB<pawn>(black) & Not_h_file) >> 9);
-    else
-        mobilityNet &= ~((mState.getPieceBB<pawn>(white) & Not_a_file) << 9
-                       | (mState.getPieceBB<pawn>(white) & Not_h_file) << 7);
+    mobilityNet = mState.getEmptyBB() & ~mPawns->getAttacks(!c);
 
     // Get the pinned pieces for the current player.
     pins = mState.getPinsBB(c);
@@ -217,7 +296,6 @@ void Evaluate::evalPieces(const Color c)
     {
         if (p == no_sq)
             break;
-        mMaterial[c] += Knight_wt;
         mMaterial[c] += outpost<knight>(p, c);
 
         if (square_bb[p] & pins)
@@ -241,7 +319,6 @@ void Evaluate::evalPieces(const Color c)
     {
         if (p == no_sq)
             break;
-        mMaterial[c] += Bishop_wt;
         mMaterial[c] += outpost<bishop>(p, c);
 
         moves = mState.getAttackBB<bishop>(p);
@@ -267,8 +344,6 @@ void Evaluate::evalPieces(const Color c)
     {
         if (p == no_sq)
             break;
-        mMaterial[c] += Rook_wt;
-
         moves = mState.getAttackBB<rook>(p);
         if (square_bb[p] & pins)
             moves &= coplanar[p][kingSq];
@@ -302,7 +377,6 @@ void Evaluate::evalPieces(const Color c)
     {
         if (p == no_sq)
             break;
-        mMaterial[c] += Queen_wt;
         moves = mState.getAttackBB<queen>(p);
         if (square_bb[p] & pins)
             moves &= coplanar[p][kingSq];
@@ -352,8 +426,8 @@ std::ostream& operator<<(std::ostream& o, const Evaluate& e)
     Color c = e.mState.getOurColor();
     std::string us = c == white ? "White" : "Black";
     std::string them = c == white ? "Black" : "White";
-    int pstMid = e.mState.getPstScore(middle) * (256 - e.mGamePhase) / 256;
-    int pstLate = e.mState.getPstScore(late) * e.mGamePhase / 256;
+    int pstMid = mg_value(e.mState.getPstScore()) * (256 - e.mGamePhase) / 256;
+    int pstLate = eg_value(e.mState.getPstScore()) * e.mGamePhase / 256;
 
     o << e.mState
       << "-------------------------------------------------------------\n"
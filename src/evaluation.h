@@ -7,6 +7,8 @@
 #include <algorithm>
 #include "state.h"
 #include "pst.h"
+#include "pawn_hash.h"
+#include "material.h"
 
 static const int tempo = 15;
 
@@ -32,12 +34,15 @@ static const int TrappedRook    = -25;
 static const int StrongPawnAttack = -80;
 static const int WeakPawnAttack = -40;
 static const int Hanging        = -25;
+static const int ShelterNear    = 10;   // Pawn shelter, cached but not scored.
+static const int ShelterFar     = 5;
+static const int ShelterNone    = -10;
+
+static const int Lazy_margin    = 400;
 
 static const int Midgame_limit  = 4500;
 static const int Lategame_limit = 2500;
 
-static const size_t hash_size = 8192;
-
 static const int Safety_table[100] = 
 {
       0,   0,   1,   2,   3,   5,   7,   9,  12,  15,
@@ -73,68 +78,29 @@ static const int queenMobility[] =
     50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50
 };
 
-struct PawnEntry
-{
-    PawnEntry()
-    : mKey(0), mStructure{}
-    {}
-    U64 getKey() const
-    {
-        return mKey;
-    }
-    const std::array<int, Player_size>& getStructure() const
-    {
-        return mStructure;
-    }
-    const std::array<int, Player_size>& getMaterial() const
-    {
-        return mMaterial;
-    }
-    U64 mKey;
-    std::array<int, Player_size> mStructure;
-    std::array<int, Player_size> mMaterial;
-};
-
-static std::array<PawnEntry, hash_size> pawnHash;
-
-inline void init_eval()
-{
-    std::fill(pawnHash.begin(), pawnHash.end(), PawnEntry());
-}
-
-
-inline PawnEntry* probe(U64 pKey)
-{
-    return &pawnHash[pKey % pawnHash.size()];
-}
-
-inline void store(U64 pKey, 
-                  const std::array<int, Player_size>& pStructure,
-                  const std::array<int, Player_size>& pMaterial)
-{
-    pawnHash[pKey % pawnHash.size()].mKey = pKey;
-    pawnHash[pKey % pawnHash.size()].mStructure = pStructure;
-    pawnHash[pKey % pawnHash.size()].mMaterial = pMaterial;
-}
-
 //int evaluate(const State & s);
 
 class Evaluate
 {
 public:
-    Evaluate(const State& pState);
+    Evaluate(const State& pState, PawnHash& pPawnHash, const MaterialEntry& pMaterial,
+             int pAlpha = Neg_inf, int pBeta = Pos_inf);
     // Returns the score of a bishop or rook on an outpost square.
     template<PieceType PT>
     int outpost(Square p, Color c);
-    void evalPawns(const Color c);
+    void evalPawns(const Color c, PawnEntry& e);
+    void evalShelter(const Color c, PawnEntry& e);
     void evalPieces(const Color c);
     void evalAttacks(Color c);
     int getScore() const;
+    bool isLazy() const;
     friend std::ostream& operator<<(std::ostream& o, const Evaluate& e);
 private:
-    float mGamePhase;
+    int mGamePhase;
     const State& mState;
+    const PawnEntry* mPawns;
     int mScore;
+    bool mLazy;
     std::array<int, Player_size> mMobility;
     std::array<int, Player_size> mKingSafety;
     std::array<int, Player_size> mPawnStructure;
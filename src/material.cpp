@@ -0,0 +1,48 @@
+#include "material.h"
+
+void MaterialHash::compute(const State& s, MaterialEntry& e)
+{
+    e = MaterialEntry();
+    e.mKey = s.getMaterialKey();
+
+    const int phase = totalPhase
+                    - s.getPieceCount<knight>() * knightPhase
+                    - s.getPieceCount<bishop>() * bishopPhase
+                    - s.getPieceCount<rook>()   * rookPhase
+                    - s.getPieceCount<queen>()  * queenPhase;
+    e.mPhase = (phase * 256 + (totalPhase / 2)) / totalPhase;
+
+    for (Color c : { white, black })
+    {
+        const int pawns = s.getPieceCount<pawn>(c);
+        e.mMaterial[c] = s.getPieceCount<knight>(c) * Knight_wt
+                       + s.getPieceCount<bishop>(c) * Bishop_wt
+                       + s.getPieceCount<rook>(c)   * Rook_wt
+                       + s.getPieceCount<queen>(c)  * Queen_wt;
+
+        if (s.getPieceCount<bishop>(c) >= 2)
+            e.mImbalance[c] += BishopPair;
+        e.mImbalance[c] += s.getPieceCount<knight>(c) * KnightPawns * (pawns - 5);
+        e.mImbalance[c] += s.getPieceCount<rook>(c)   * RookPawns   * (pawns - 5);
+    }
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Insufficient material, the same rules as State::insufficientMaterial. With //
+// no pawns or majors: bishops only and all on one color, a single knight, or //
+// one knight each.                                                           //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    if (s.getPieceCount<pawn>() + s.getPieceCount<rook>() + s.getPieceCount<queen>() == 0)
+    {
+        const int knights = s.getPieceCount<knight>();
+        const int bishops = s.getPieceCount<bishop>();
+        if (knights == 0)
+            e.mInsufficient = bishops <= 1 ? alwaysDrawn : drawnIfBishopsAlike;
+        else if (knights == 1 && !bishops)
+            e.mInsufficient = alwaysDrawn;
+        else if (knights == 2 && !bishops
+              && s.getPieceCount<knight>(white) && s.getPieceCount<knight>(black))
+            e.mInsufficient = alwaysDrawn;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "state.h"
+#include "types.h"
+
+const int Material_hash_size = 8192;             // Entries, a power of two.
+
+// Imbalance weights, zero until they are tuned and tested.
+static const int BishopPair     = 0;
+static const int KnightPawns    = 0;             // Per own pawn above five.
+static const int RookPawns      = 0;             // Per own pawn above five.
+
+enum Insufficient : uint8_t
+{
+    neverDrawn,
+    alwaysDrawn,
+    drawnIfBishopsAlike                          // Only bishops, one color.
+};
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Everything that only depends on how many of each piece both sides have.    //
+// Looked up by State::getMaterialKey, so it is computed once per material    //
+// signature instead of at every node:                                        //
+//   phase         game phase, 0 - 256 like State::getGamePhase               //
+//   material      weight of the non-pawn pieces for each side                //
+//   imbalance     bishop pair and piece/pawn count adjustments               //
+//   insufficient  when the position is a dead draw                           //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct MaterialEntry
+{
+    MaterialEntry()
+    : mKey(0), mPhase(0), mMaterial{}, mImbalance{}, mInsufficient(neverDrawn)
+    {}
+    bool isDraw(const State& s) const
+    {
+        if (mInsufficient == drawnIfBishopsAlike)
+            return !(s.getPieceBB<bishop>() & Dark_squares)
+                || !(s.getPieceBB<bishop>() & Light_squares);
+        return mInsufficient == alwaysDrawn;
+    }
+    U64 mKey;
+    int mPhase;
+    std::array<int, Player_size> mMaterial;
+    std::array<int, Player_size> mImbalance;
+    Insufficient mInsufficient;
+};
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A direct mapped table of material entries, one per search thread. A miss   //
+// recomputes the entry from the piece counts in place.                       //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+class MaterialHash
+{
+public:
+    MaterialHash()
+    : mTable(Material_hash_size)
+    {}
+    const MaterialEntry* probe(const State& s)
+    {
+        MaterialEntry* e = &mTable[s.getMaterialKey() & (Material_hash_size - 1)];
+        if (e->mKey != s.getMaterialKey())
+            compute(s, *e);
+        return e;
+    }
+private:
+    static void compute(const State& s, MaterialEntry& e);
+    std::vector<MaterialEntry> mTable;
+};
+
+#endif
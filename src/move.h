@@ -85,7 +85,7 @@ inline std::string toString(Move m)
 	src = getSrc(m);
 	dst = getDst(m);
 
-	ret = SQ[src] + SQ[dst];
+	ret = std::string(SQ[src]) + SQ[dst];
 
 	switch (getPiecePromo(m))
 	{
@@ -1,18 +1,34 @@
 
 #include "move_generator.h"
 
-// ----------------------------------------------------------------------------
-// Initialize magicmState.
-// ----------------------------------------------------------------------------
-
-void mg_init()
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A stable sort by score. Move lists are short enough that insertion sort    //
+// beats std::stable_sort, which also allocates a temporary buffer per call.  //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+template<typename It>
+static void insertionSort(It first, It last)
 {
-    initmagicmoves();
+    if (first == last)
+        return;
+
+    for (It i = first + 1; i != last; ++i)
+    {
+        MoveEntry entry = *i;
+        It j = i;
+        for (; j != first && entry < *(j - 1); --j)
+            *j = *(j - 1);
+        *j = entry;
+    }
 }
 
 MoveList::MoveList(const State& pState, Move pBest, History* pHistory, int pPly, bool pQSearch)
-: mState(pState), mValid(Full), mBest(pBest), mQSearch(pQSearch), mKiller1(nullMove), mKiller2(nullMove)
-, mSize(0), mHistory(pHistory), mPly(pPly)
+: mQSearch(pQSearch), mValid(Full)
+, mPinned(pState.getPinsBB(pState.getOurColor()))
+, mKing(pState.getKingSquare(pState.getOurColor()))
+, mState(pState), mHistory(pHistory), mPly(pPly)
+, mSize(0), mBadSize(0), mBest(pBest), mKiller1(nullMove), mKiller2(nullMove)
 {
     if (pHistory)
     {
@@ -22,9 +38,8 @@ MoveList::MoveList(const State& pState, Move pBest, History* pHistory, int pPly,
 
     if (mState.inCheck())
     {
-        Square k = mState.getKingSquare(mState.getOurColor());
         Square c = get_lsb(mState.getCheckersBB());
-        mValid = between[k][c] | mState.getCheckersBB();
+        mValid = between[mKing][c] | mState.getCheckersBB();
         mStage = nEvadeBestMove;
     }
     else
@@ -52,11 +67,44 @@ bool MoveList::contains(Move move) const
             != mList.begin() + mSize;
 }
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A pinned piece may only move along the line through its king. Knights      //
+// never can, since no knight move stays on a line through its source.        //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+bool MoveList::breaksPin(Square src, Square dst) const
+{
+    return square_bb[src] & mPinned
+        && !(coplanar[src][dst] & square_bb[mKing]);
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// En-passant removes two pawns from one rank, which the pin mask can't see   //
+// (both pawns can sit between the king and a rook on the fifth rank). Replay //
+// the capture on the occupancy and look for a slider on the king. Any other  //
+// checker must be the captured pawn, or the capture does not evade check.    //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+bool MoveList::legalEnPassant(Square src, Square dst) const
+{
+    const Color C = mState.getOurColor();
+    Square cap = C == white ? dst - 8 : dst + 8;
+    U64 occ = mState.getOccupancyBB() ^ square_bb[src] ^ square_bb[cap] ^ square_bb[dst];
+
+    return !(bishop_attacks(mKing, occ) & (mState.getPieceBB<bishop>(!C) | mState.getPieceBB<queen>(!C)))
+        && !(rook_attacks(mKing, occ) & (mState.getPieceBB<rook>(!C) | mState.getPieceBB<queen>(!C)))
+        && !(mState.getCheckersBB() & ~square_bb[cap]
+             & (mState.getPieceBB<pawn>(!C) | mState.getPieceBB<knight>(!C)));
+}
+
 template<MoveType T>
 void MoveList::pushPromotion(Square src, Square dst)
 {
     const Color C = mState.getOurColor();
-    if (square_bb[dst] & Not_a_file && square_bb[dst+1] & mState.getOccupancyBB(!C))
+    if (square_bb[dst] & Not_a_file && square_bb[dst+1] & mState.getOccupancyBB(!C)
+        && !breaksPin(src, dst+1))
     {
         if (T == MoveType::Attacks || T == MoveType::All)
             push(makeMove(src, dst+1, queen));
@@ -86,7 +134,8 @@ void MoveList::pushPromotion(Square src, Square dst)
         }
     }
 
-    if (square_bb[dst] & Not_h_file && square_bb[dst-1] & mState.getOccupancyBB(!C))
+    if (square_bb[dst] & Not_h_file && square_bb[dst-1] & mState.getOccupancyBB(!C)
+        && !breaksPin(src, dst-1))
     {
         if (T == MoveType::Attacks || T == MoveType::All)
             push(makeMove(src, dst-1, queen));
@@ -116,7 +165,7 @@ void MoveList::pushPromotion(Square src, Square dst)
         }
     }
 
-    if (square_bb[dst] & mState.getEmptyBB())
+    if (square_bb[dst] & mState.getEmptyBB() && !breaksPin(src, dst))
     {
         if (T == MoveType::Attacks || T == MoveType::All)
             push(makeMove(src, dst, queen));
@@ -161,6 +210,14 @@ void MoveList::pushMoves()
 
         m = mState.getAttackBB<P>(src) & mValid;
 
+        if (P == king)
+        {
+            mDanger = mState.getThreatsBB(!c, mState.getOccupancyBB() ^ square_bb[src]);
+            m &= ~mDanger;
+        }
+        else if (square_bb[src] & mPinned)
+            m &= coplanar[mKing][src];
+
         if (T == MoveType::QuietChecks)
         {
             if (square_bb[src] & mDiscover)
@@ -214,13 +271,17 @@ void MoveList::pushPawnMoves()
         while (left)
         {
             dst = pop_lsb(left);
-            push(makeMove(dst - L, dst));
+            if (square_bb[dst] & mState.getEnPassantBB() ? legalEnPassant(dst - L, dst)
+                                                         : !breaksPin(dst - L, dst))
+                push(makeMove(dst - L, dst));
         }
 
         while (right)
         {
             dst = pop_lsb(right);
-            push(makeMove(dst - R, dst));
+            if (square_bb[dst] & mState.getEnPassantBB() ? legalEnPassant(dst - R, dst)
+                                                         : !breaksPin(dst - R, dst))
+                push(makeMove(dst - R, dst));
         }
     }
 
@@ -255,13 +316,15 @@ void MoveList::pushPawnMoves()
         while (up)
         {
             dst = pop_lsb(up);
-            push(makeMove(dst - U, dst));
+            if (!breaksPin(dst - U, dst))
+                push(makeMove(dst - U, dst));
         }
 
         while (dbl)
         {
             dst = pop_lsb(dbl);
-            push(makeMove(dst - U - U, dst));
+            if (!breaksPin(dst - U - U, dst))
+                push(makeMove(dst - U - U, dst));
         }
     }
 }
@@ -269,12 +332,11 @@ void MoveList::pushPawnMoves()
 template<MoveType T>
 void MoveList::pushCastle()
 {
-    Square k = mState.getKingSquare(mState.getOurColor());
+    Square k = mKing;
 
     if (mState.canCastleKingside() &&
         !(between_hor[k][k-3] & mState.getOccupancyBB()) &&
-        !mState.attacked(k-1) && 
-        !mState.attacked(k-2)) 
+        !(mDanger & (square_bb[k-1] | square_bb[k-2])))
     {
         if (T == MoveType::QuietChecks)
         {
@@ -287,8 +349,7 @@ void MoveList::pushCastle()
 
     if (mState.canCastleQueenside() && 
         !(between_hor[k][k+4] & mState.getOccupancyBB()) && 
-        !mState.attacked(k+1) && 
-        !mState.attacked(k+2))
+        !(mDanger & (square_bb[k+1] | square_bb[k+2])))
     {
         if (T == MoveType::QuietChecks)
         {
@@ -300,22 +361,6 @@ void MoveList::pushCastle()
     }
 }
 
-// ---------------------------------------------------------------------------//
-//                                                                            //
-// Run through the move list. Remove any moves where the source location      //
-// is a pinned piece and the king square is not on the line formed by the     //
-// source and destination locationmState.                                     //
-//                                                                            //
-// -------------------------------------------------------------------------- //
-void MoveList::checkLegal()
-{
-    for (int i = 0; i < mSize; ++i)
-    {
-        if (!mState.isLegal(mList[i].move))
-            mList[i--] = mList[--mSize];
-    }
-}
-
 template<MoveType T>
 void MoveList::generateMoves()
 {
@@ -342,7 +387,7 @@ void MoveList::generateMoves<MoveType::Evasions>()
 {
     assert(mState.inCheck());
 
-    Square k, c;
+    Square c;
 
     mValid = mState.getOccupancyBB(mState.getTheirColor()) | mState.getEmptyBB();
     pushMoves<MoveType::Evasions, king>();
@@ -350,9 +395,8 @@ void MoveList::generateMoves<MoveType::Evasions>()
     if (mState.inDoubleCheck())
         return;
 
-    k = mState.getKingSquare(mState.getOurColor());
     c = get_lsb(mState.getCheckersBB());
-    mValid = between[k][c] | mState.getCheckersBB();
+    mValid = between[mKing][c] | mState.getCheckersBB();
 
     mState.getOurColor() == white ? pushPawnMoves<MoveType::Evasions, white>() 
                                   : pushPawnMoves<MoveType::Evasions, black>();
@@ -421,23 +465,27 @@ Move MoveList::getBestMove()
 // their LVA-MVV (least valuable attacker, most valuable victim) score. I     //
 // just do Victim - Attacker.                                                 //
 //                                                                            //
-// If the see value is negative, store the see value as the score.            //
+// The sign is all that matters for good captures, so seeGe answers that and  //
+// the full see value is only computed for the losing ones.                   //
+//                                                                            //
+// If the see value is negative, store the see value as the score and move    //
+// the capture to the back of mList, where it waits until the quiets are      //
+// done. A position has far fewer than maxSize legal moves, so the quiets     //
+// generated later never reach it.                                            //
 //                                                                            //
 // ---------------------------------------------------------------------------//
         case nAttacksGen:
             generateMoves<MoveType::Attacks>();
             for (int i = 0; i < mSize; ++i)
             {
-                int see = mState.see(mList[i].move);
-                if (see >= 0)
+                if (mState.seeGe(mList[i].move, 0))
                     mList[i].score = mState.onSquare(getDst(mList[i].move))
                                    - mState.onSquare(getSrc(mList[i].move));
                 else
                 {
-                    mList[i].score = see;
-                    badCaptures.push_back(mList[i]);
-                    std::swap(mList[i], mList[mSize - 1]);
-                    pop();
+                    mList[i].score = mState.see(mList[i].move);
+                    mList[maxSize - ++mBadSize] = mList[i];
+                    mList[i--] = mList[--mSize];
                 }
             }
             mStage++;
@@ -457,8 +505,7 @@ Move MoveList::getBestMove()
                 std::iter_swap(std::max_element(mList.begin(), mList.begin() + mSize), 
                                mList.begin() + mSize - 1);
                 move = pop();
-                if (move != mBest
-                    && mState.isLegal(move))
+                if (move != mBest)
                     return move;
             }
             mStage++;
@@ -522,7 +569,7 @@ Move MoveList::getBestMove()
                 mList[i].score = mHistory->getHistoryScore(mList[i].move);
             auto it2 = 
                 std::partition(mList.begin(), mList.begin() + mSize, noScore);
-            std::stable_sort(it2, mList.begin() + mSize);
+            insertionSort(it2, mList.begin() + mSize);
             auto it1 = mList.begin();
             for (auto it1 = mList.begin(); it1 != it2; ++it1)
             {
@@ -538,7 +585,7 @@ Move MoveList::getBestMove()
                                                       mState.getOurColor(), 
                                                       src);
             }
-            std::stable_sort(mList.begin(), it2);
+            insertionSort(mList.begin(), it2);
             mStage++;
         }
 // ---------------------------------------------------------------------------//
@@ -554,16 +601,13 @@ Move MoveList::getBestMove()
                 move = pop();
                 if (move != mBest
                     && move != mKiller1
-                    && move != mKiller2
-                    && mState.isLegal(move))
+                    && move != mKiller2)
                     return move;
             }
-            while (!badCaptures.empty())
+            while (mBadSize)
             {
-                move = badCaptures.back().move;
-                badCaptures.pop_back();
-                if (move != mBest
-                    && mState.isLegal(move))
+                move = mList[maxSize - mBadSize--].move;
+                if (move != mBest)
                     return move;
             }
             break;
@@ -614,10 +658,9 @@ Move MoveList::getBestMove()
                 std::iter_swap(std::max_element(mList.begin(), mList.begin() + mSize), 
                                mList.begin() + mSize - 1);
                 move = pop();
-                if (mState.see(move) < 0 && !isPromotion(move))
+                if (!isPromotion(move) && !mState.seeGe(move, 0))
                     continue;
-                if (move != mBest
-                    && mState.isLegal(move))
+                if (move != mBest)
                     return move;
             }
             mStage++;
@@ -657,8 +700,7 @@ Move MoveList::getBestMove()
                 std::iter_swap(std::max_element(mList.begin(), mList.begin() + mSize), 
                                mList.begin() + mSize - 1);
                 move = pop();
-                if (move != mBest
-                    && mState.isLegal(move))
+                if (move != mBest)
                     return move;
             }
             break;
@@ -691,12 +733,11 @@ Move MoveList::getBestMove()
             {
                 if (mState.isCapture(mList[i].move))
                 {
-                    int see = mState.see(mList[i].move);
-                    if (see >= 0)
+                    if (mState.seeGe(mList[i].move, 0))
                         mList[i].score = mState.onSquare(getDst(mList[i].move))
                                        - mState.onSquare(getSrc(mList[i].move));
                     else
-                        mList[i].score = see;
+                        mList[i].score = mState.see(mList[i].move);
                     mList[i].score |= CaptureFlag;
                 }
                 else
@@ -720,7 +761,7 @@ Move MoveList::getBestMove()
                     }
                 }
             }
-            std::stable_sort(mList.begin(), mList.begin() + mSize);
+            insertionSort(mList.begin(), mList.begin() + mSize);
             mStage++;
         }
 // ---------------------------------------------------------------------------//
@@ -733,8 +774,7 @@ Move MoveList::getBestMove()
             while (mSize)
             {
                 move = pop();
-                if (move != mBest
-                    && mState.isLegal(move))
+                if (move != mBest)
                     return move;
             }
             break;
@@ -759,10 +799,12 @@ Move MoveList::getBestMove()
 }
 
 MoveList::MoveList(const State& pState)
-: mState(pState), mValid(Full), mQSearch(false), mBest(nullMove)
-, mSize(0), mHistory(nullptr), mPly(0)
+: mQSearch(false), mValid(Full)
+, mPinned(pState.getPinsBB(pState.getOurColor()))
+, mKing(pState.getKingSquare(pState.getOurColor()))
+, mState(pState), mHistory(nullptr), mPly(0)
+, mSize(0), mBadSize(0), mBest(nullMove)
 {
     generateMoves<MoveType::All>();
     mStage = allLegal;
-    checkLegal();
 }
\ No newline at end of file
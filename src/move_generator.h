@@ -3,7 +3,6 @@
 
 #include <cmath>
 #include <algorithm>
-#include <vector>
 #include <array>
 #include "state.h"
 #include "bitboard.h"
@@ -54,30 +53,32 @@ public:
     bool contains(Move move) const;
     Move getBestMove();
     Move pop();
-    void checkLegal();
     template<MoveType T> void generateMoves();
 
     template<MoveType T, Color C> void pushPawnMoves();
     template<MoveType T, PieceType P> void pushMoves();
     template<MoveType T> void pushCastle();
     template<MoveType T> void pushPromotion(Square src, Square dst);
+    bool breaksPin(Square src, Square dst) const;
+    bool legalEnPassant(Square src, Square dst) const;
     friend std::ostream & operator << (std::ostream & o, const MoveList & mlist);
 private:
     bool mQSearch;
     U64 mValid;
     U64 mDiscover;
+    U64 mPinned;
+    U64 mDanger;
+    Square mKing;
     const State& mState;
     const History* mHistory;
     int mPly;
     int mStage;
-    std::array<MoveEntry, maxSize> mList;
-    std::vector<MoveEntry> badCaptures;
+    std::array<MoveEntry, maxSize> mList;       // Bad captures fill from the back.
     std::size_t mSize;
+    std::size_t mBadSize;
     Move mBest;
     Move mKiller1;
     Move mKiller2;
 };
 
-void mg_init();
-
 #endif
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include "nnue.h"
+#include "state.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define NNUE_X86
+    #include <immintrin.h>
+#endif
+
+namespace NNUE
+{
+    bool enabled = false;
+
+    const int Activation_max = 127;              // Clipped relu range.
+    const int Weight_shift = 6;                  // Hidden weights are x64.
+    const int Output_scale = 16;                 // Output units per centipawn.
+
+    // The network. The first layer is stored by feature, so a feature's
+    // contribution to the accumulator is one contiguous row of weights.
+    alignas(64) static int16_t ftBias[Hidden_size];
+    alignas(64) static int16_t ftWeights[Input_size * Hidden_size];
+    alignas(64) static int32_t l1Bias[L1_size];
+    alignas(64) static int16_t l1Weights[L1_size * 2 * Hidden_size];
+    alignas(64) static int32_t l2Bias[L2_size];
+    alignas(64) static int16_t l2Weights[L2_size * L1_size];
+    static int32_t outBias;
+    alignas(64) static int16_t outWeights[L2_size];
+    static bool mLoaded = false;
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Kernels. Every loop over int16 vectors goes through one of these, picked   //
+// once at startup from what the cpu supports. The vector versions are built  //
+// with per function target attributes, so the rest of the engine still runs  //
+// on any x86-64. Vector widths and the four row blocks divide the layer      //
+// sizes.                                                                     //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    struct Kernels
+    {
+        const char* name;
+        void (*update)(int16_t* values, const int16_t* removed, const int16_t* added);
+        void (*clip)(const int16_t* in, int16_t* out, int size);
+        void (*affine)(const int16_t* in, int inSize, const int16_t* weights,
+                       const int32_t* bias, int16_t* out, int outSize);
+        int32_t (*dot)(const int16_t* a, const int16_t* b, int size);
+    };
+
+    static void updateScalar(int16_t* values, const int16_t* removed, const int16_t* added)
+    {
+        for (int i = 0; i < Hidden_size; ++i)
+            values[i] += (added ? added[i] : 0) - (removed ? removed[i] : 0);
+    }
+
+    static void clipScalar(const int16_t* in, int16_t* out, int size)
+    {
+        for (int i = 0; i < size; ++i)
+            out[i] = std::max<int16_t>(0, std::min<int16_t>(in[i], Activation_max));
+    }
+
+    static int32_t dotScalar(const int16_t* a, const int16_t* b, int size)
+    {
+        int32_t sum = 0;
+        for (int i = 0; i < size; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    static void affineScalar(const int16_t* in, int inSize, const int16_t* weights,
+                             const int32_t* bias, int16_t* out, int outSize)
+    {
+        for (int j = 0; j < outSize; ++j)
+        {
+            int32_t sum = (bias[j] + dotScalar(in, weights + j * inSize, inSize)) >> Weight_shift;
+            out[j] = std::max(0, std::min(sum, Activation_max));
+        }
+    }
+
+#if defined(NNUE_X86)
+    __attribute__((target("sse4.1")))
+    static void updateSse(int16_t* values, const int16_t* removed, const int16_t* added)
+    {
+        for (int i = 0; i < Hidden_size; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            if (removed)
+                v = _mm_sub_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(removed + i)));
+            if (added)
+                v = _mm_add_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(added + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), v);
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static void clipSse(const int16_t* in, int16_t* out, int size)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max = _mm_set1_epi16(Activation_max);
+        for (int i = 0; i < size; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            v = _mm_min_epi16(_mm_max_epi16(v, zero), max);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static int32_t dotSse(const int16_t* a, const int16_t* b, int size)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < size; i += 8)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(x, y));
+        }
+        sum = _mm_hadd_epi32(sum, sum);
+        sum = _mm_hadd_epi32(sum, sum);
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    // Four outputs at a time, so each input vector is loaded once per four
+    // rows and the horizontal sums are shared.
+    __attribute__((target("sse4.1")))
+    static void affineSse(const int16_t* in, int inSize, const int16_t* weights,
+                          const int32_t* bias, int16_t* out, int outSize)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max = _mm_set1_epi32(Activation_max);
+        for (int j = 0; j < outSize; j += 4)
+        {
+            const int16_t* w = weights + j * inSize;
+            __m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+            for (int i = 0; i < inSize; i += 8)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                s0 = _mm_add_epi32(s0, _mm_madd_epi16(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i))));
+                s1 = _mm_add_epi32(s1, _mm_madd_epi16(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + inSize + i))));
+                s2 = _mm_add_epi32(s2, _mm_madd_epi16(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + 2 * inSize + i))));
+                s3 = _mm_add_epi32(s3, _mm_madd_epi16(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + 3 * inSize + i))));
+            }
+            __m128i sum = _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+            sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + j)));
+            sum = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(sum, Weight_shift), zero), max);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + j), _mm_packs_epi32(sum, sum));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void updateAvx2(int16_t* values, const int16_t* removed, const int16_t* added)
+    {
+        for (int i = 0; i < Hidden_size; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            if (removed)
+                v = _mm256_sub_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(removed + i)));
+            if (added)
+                v = _mm256_add_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(added + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), v);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void clipAvx2(const int16_t* in, int16_t* out, int size)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max = _mm256_set1_epi16(Activation_max);
+        for (int i = 0; i < size; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            v = _mm256_min_epi16(_mm256_max_epi16(v, zero), max);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static int32_t dotAvx2(const int16_t* a, const int16_t* b, int size)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < size; i += 16)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+    }
+
+    __attribute__((target("avx2")))
+    static void affineAvx2(const int16_t* in, int inSize, const int16_t* weights,
+                           const int32_t* bias, int16_t* out, int outSize)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i max = _mm_set1_epi32(Activation_max);
+        for (int j = 0; j < outSize; j += 4)
+        {
+            const int16_t* w = weights + j * inSize;
+            __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+            for (int i = 0; i < inSize; i += 16)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i))));
+                s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + inSize + i))));
+                s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + 2 * inSize + i))));
+                s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + 3 * inSize + i))));
+            }
+            __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3));
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + j)));
+            sum = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(sum, Weight_shift), zero), max);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + j), _mm_packs_epi32(sum, sum));
+        }
+    }
+#endif
+
+    static Kernels kernels = { "scalar", updateScalar, clipScalar, affineScalar, dotScalar };
+
+    void init()
+    {
+#if defined(NNUE_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            kernels = { "avx2", updateAvx2, clipAvx2, affineAvx2, dotAvx2 };
+        else if (__builtin_cpu_supports("sse4.1"))
+            kernels = { "sse4.1", updateSse, clipSse, affineSse, dotSse };
+#endif
+    }
+
+    const char* simd()
+    {
+        return kernels.name;
+    }
+
+    bool loaded()
+    {
+        return mLoaded;
+    }
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Network files are a small header followed by the raw little endian         //
+// parameters in the order they are declared above. The header holds the      //
+// layer sizes, so a file for a different architecture is refused instead of  //
+// being read as garbage.                                                     //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    static const char Net_file_magic[8] = { 'C', 'G', 'N', 'N', 'U', 'E', 0, 0 };
+    static const uint32_t Net_file_version = 1;
+
+    struct NetFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t inputs;
+        uint32_t hidden;
+        uint32_t l1;
+        uint32_t l2;
+    };
+
+    template<typename T>
+    static bool read(std::ifstream& file, T* data, std::size_t count)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(data), count * sizeof(T)));
+    }
+
+    bool load(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        NetFileHeader header;
+        const char* error = nullptr;
+
+        if (!file || !read(file, &header, 1))
+            error = "failed to open network file";
+        else if (std::memcmp(header.magic, Net_file_magic, sizeof(Net_file_magic))
+              || header.version != Net_file_version)
+            error = "not a network file";
+        else if (header.inputs != Input_size || header.hidden != Hidden_size
+              || header.l1 != L1_size || header.l2 != L2_size)
+            error = "network file has a different architecture";
+        else if (!read(file, ftBias, Hidden_size)
+              || !read(file, ftWeights, static_cast<std::size_t>(Input_size) * Hidden_size)
+              || !read(file, l1Bias, L1_size)
+              || !read(file, l1Weights, L1_size * 2 * Hidden_size)
+              || !read(file, l2Bias, L2_size)
+              || !read(file, l2Weights, L2_size * L1_size)
+              || !read(file, &outBias, 1)
+              || !read(file, outWeights, L2_size)
+              || file.peek() != std::ifstream::traits_type::eof())
+            error = "network file is truncated or corrupt";
+
+        mLoaded = !error;
+        if (error)
+            std::cout << "info string " << error << ' ' << path << std::endl;
+        return mLoaded;
+    }
+
+    // Add, remove or move one feature. Either index may be No_feature.
+    void update(int16_t* values, int removed, int added)
+    {
+        kernels.update(values,
+                       removed == No_feature ? nullptr : ftWeights + removed * Hidden_size,
+                       added == No_feature ? nullptr : ftWeights + added * Hidden_size);
+    }
+
+    // Recompute one side's accumulator from the pieces on the board.
+    void refresh(Accumulator& acc, const State& s, Color perspective)
+    {
+        const Square kingSq = s.getKingSquare(perspective);
+        U64 pieces = s.getOccupancyBB() & ~s.getPieceBB<king>();
+
+        std::memcpy(acc.values[perspective], ftBias, sizeof(ftBias));
+        while (pieces)
+        {
+            Square sq = pop_lsb(pieces);
+            Color c = s.getOccupancyBB(white) & square_bb[sq] ? white : black;
+            int index = featureIndex(perspective, kingSq, c, s.onSquare(sq), sq);
+            kernels.update(acc.values[perspective], nullptr, ftWeights + index * Hidden_size);
+        }
+        acc.dirty[perspective] = false;
+    }
+
+    // Score of s for the side to move, in centipawns.
+    int evaluate(const State& s)
+    {
+        const Accumulator& acc = s.getAccumulator();
+        alignas(64) int16_t input[2 * Hidden_size];
+        alignas(64) int16_t hidden1[L1_size];
+        alignas(64) int16_t hidden2[L2_size];
+
+        assert(!acc.dirty[white] && !acc.dirty[black]);
+
+        kernels.clip(acc.values[s.getOurColor()], input, Hidden_size);
+        kernels.clip(acc.values[s.getTheirColor()], input + Hidden_size, Hidden_size);
+        kernels.affine(input, 2 * Hidden_size, l1Weights, l1Bias, hidden1, L1_size);
+        kernels.affine(hidden1, L1_size, l2Weights, l2Bias, hidden2, L2_size);
+
+        return (outBias + kernels.dot(hidden2, outWeights, L2_size)) / Output_scale;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <cstdint>
+#include <string>
+#include "types.h"
+
+class State;
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// An optional neural network evaluation, used in place of Evaluate when the  //
+// UseNNUE option is on and a network has been loaded.                        //
+//                                                                            //
+// The input layer is HalfKP: one feature for every (own king square, non     //
+// king piece, square) triple, seen once from each side. Black's features are //
+// flipped vertically, so both sides see the board from their own first rank. //
+// The first layer's output per side is kept in an accumulator inside State   //
+// and updated as pieces are added, moved and removed. A king move changes    //
+// every feature of its side, so that side is marked dirty and recomputed     //
+// from scratch at the end of make_t.                                         //
+//                                                                            //
+// The two accumulators, side to move first, go through clipped relu and two  //
+// small int16 layers to a single output in centipawns:                       //
+//                                                                            //
+//   40960 -> 2 x 256 -> 32 -> 32 -> 1                                        //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+namespace NNUE
+{
+    const int Piece_features = 10 * Board_size;    // Non king pieces, both colors.
+    const int Input_size = Board_size * Piece_features;
+    const int Hidden_size = 256;                   // Accumulator width per side.
+    const int L1_size = 32;
+    const int L2_size = 32;
+    const int No_feature = -1;
+
+    extern bool enabled;                           // UseNNUE and a net loaded.
+
+    struct Accumulator
+    {
+        int16_t values[Player_size][Hidden_size];
+        bool dirty[Player_size];
+    };
+
+    // Index of piece p of color c on square s, as seen by perspective with
+    // its king on kingSq.
+    inline int featureIndex(Color perspective, Square kingSq, Color c, PieceType p, Square s)
+    {
+        const int flip = perspective == white ? 0 : 56;
+        return (int(kingSq) ^ flip) * Piece_features
+             + (2 * p + (c != perspective)) * Board_size
+             + (int(s) ^ flip);
+    }
+
+    void init();
+    bool load(const std::string& path);
+    bool loaded();
+    const char* simd();
+    void update(int16_t* values, int removed, int added);
+    void refresh(Accumulator& acc, const State& s, Color perspective);
+    int evaluate(const State& s);
+}
+
+#endif
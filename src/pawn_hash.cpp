@@ -0,0 +1,29 @@
+#include "pawn_hash.h"
+
+PawnHash::PawnHash()
+: mMask(0), mSize(0)
+{
+    resize(Default_pawn_size);
+}
+
+// Resize to the largest power of two entry count that fits in size_mb MiB.
+// Does nothing if the size hasn't changed.
+void PawnHash::resize(int size_mb)
+{
+    if (size_mb == mSize)
+        return;
+
+    std::size_t entries = 1;
+    while (entries * 2 * sizeof(PawnEntry) <= (static_cast<std::size_t>(size_mb) << 20))
+        entries *= 2;
+
+    mTable.assign(entries, PawnEntry());
+    mTable.shrink_to_fit();
+    mMask = entries - 1;
+    mSize = size_mb;
+}
+
+void PawnHash::clear()
+{
+    std::fill(mTable.begin(), mTable.end(), PawnEntry());
+}
@@ -0,0 +1,106 @@
+#ifndef PAWN_HASH_H
+#define PAWN_HASH_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "bitboard.h"
+#include "types.h"
+
+const int Default_pawn_size = 1;                 // Default pawn hash in MiB.
+const int Max_pawn_size = 256;                   // Max pawn hash in MiB.
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Everything about a pawn structure that doesn't depend on the other pieces. //
+// Computed once per pawn key by Evaluate::evalPawns and reused for every     //
+// position with the same pawns:                                              //
+//   structure   passed/candidate/isolated/... score                          //
+//   material    pawn material                                                //
+//   passed      passed pawns                                                 //
+//   attacks     squares attacked by pawns                                    //
+//   attackSpan  squares pawns attack now or after advancing                  //
+//   semiOpen    one bit per file without a pawn of that color                //
+//   shelter     pawn shelter score for a king on each file                   //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct PawnEntry
+{
+    PawnEntry()
+    : mKey(0), mStructure{}, mMaterial{}, mPassed{}, mAttacks{}, mAttackSpan{}
+    , mShelter{}, mSemiOpen{}
+    {}
+    U64 getKey() const
+    {
+        return mKey;
+    }
+    const std::array<int, Player_size>& getStructure() const
+    {
+        return mStructure;
+    }
+    const std::array<int, Player_size>& getMaterial() const
+    {
+        return mMaterial;
+    }
+    U64 getPassed(Color c) const
+    {
+        return mPassed[c];
+    }
+    U64 getAttacks(Color c) const
+    {
+        return mAttacks[c];
+    }
+    U64 getAttackSpan(Color c) const
+    {
+        return mAttackSpan[c];
+    }
+    bool isSemiOpen(Color c, Square s) const
+    {
+        return mSemiOpen[c] & (1 << file(s));
+    }
+    int getShelter(Color c, Square king) const
+    {
+        return mShelter[c][file(king)];
+    }
+    U64 mKey;
+    std::array<int, Player_size> mStructure;
+    std::array<int, Player_size> mMaterial;
+    U64 mPassed[Player_size];
+    U64 mAttacks[Player_size];
+    U64 mAttackSpan[Player_size];
+    int16_t mShelter[Player_size][8];
+    uint8_t mSemiOpen[Player_size];
+};
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A direct mapped table of pawn entries. Each search thread owns one, so     //
+// there is no sharing to worry about. The entry count is a power of two and  //
+// the slot is picked by masking the pawn key.                                //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+class PawnHash
+{
+public:
+    PawnHash();
+    void resize(int size_mb);
+    void clear();
+    PawnEntry* probe(U64 key);
+    void prefetch(U64 key) const;
+private:
+    std::vector<PawnEntry> mTable;
+    std::size_t mMask;
+    int mSize;                                   // In MiB.
+};
+
+inline PawnEntry* PawnHash::probe(U64 key)
+{
+    return &mTable[key & mMask];
+}
+
+inline void PawnHash::prefetch(U64 key) const
+{
+    ::prefetch(&mTable[key & mMask]);
+}
+
+#endif
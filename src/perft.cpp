@@ -2,6 +2,7 @@
 #include <vector>
 #include <condition_variable>
 #include <numeric>
+#include <algorithm>
 #include "perft.h"
 
 const int totalTests = 19;
@@ -61,6 +62,7 @@ int perft(State & s, int depth)
 
 	MoveList mlist(s);
 
+	// Every generated move is legal, so the last ply is just a count.
 	if (depth == 1)
 		return mlist.size();
 
@@ -68,9 +70,16 @@ int perft(State & s, int depth)
 
 	while (m = mlist.getBestMove())
 	{
+#if defined(MAKE_UNMAKE)
+		Undo undo;
+		s.make(m, undo);
+		nodes += perft(s, depth-1);
+		s.unmake(m, undo);
+#else
 		State c(s);
 		c.make_t(m);
 		nodes += perft(c, depth-1);
+#endif
 	}
 
 	return nodes;
@@ -190,4 +199,48 @@ void perftTestDebug()
 		std::cout << (nodes == perftResults[i] ? "Success " : "Fail ")
 		          << nodes << " == " << perftResults[i] << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+// Perft that also checks at every node that the checkers and pins make_t kept
+// up incrementally match a recomputation from scratch.
+static int perftVerify(State & s, int depth, int & errors)
+{
+	if (!s.checkersAndPinsValid())
+		++errors;
+
+	if (depth == 0 || s.getFiftyMoveRule() > 99)
+		return 1;
+
+	int nodes = 0;
+	MoveList mlist(s);
+	Move m;
+
+	while (m = mlist.getBestMove())
+	{
+#if defined(MAKE_UNMAKE)
+		Undo undo;
+		s.make(m, undo);
+		nodes += perftVerify(s, depth-1, errors);
+		s.unmake(m, undo);
+#else
+		State c(s);
+		c.make_t(m);
+		nodes += perftVerify(c, depth-1, errors);
+#endif
+	}
+
+	return nodes;
+}
+
+void perftTestVerify()
+{
+	int nodes, errors;
+	for (int i = 0; i < totalTests; ++i)
+	{
+		errors = 0;
+		State s(perftFen[i]);
+		nodes = perftVerify(s, std::min(perftDepth[i], 5), errors);
+		std::cout << (errors ? "Fail " : "Success ") << perftFen[i]
+		          << " nodes " << nodes << " errors " << errors << std::endl;
+	}
+}
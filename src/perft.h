@@ -11,8 +11,10 @@
 #include "timer.h"
 #include "move.h"
 
+int perft(State & s, int depth);
 void perftTest();
 void perftTestDebug();
+void perftTestVerify();
 void printPerft();
 
 #endif
\ No newline at end of file
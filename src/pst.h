@@ -8,10 +8,7 @@
 namespace PieceSquareTable
 {
 
-inline int getScore(PieceType p, GameStage g, Color c, Square s);
-inline int iScore(float phase, PieceType p, Color c, Square s);
-
-const int pst[Types_size][gameStageSize][Player_size][Board_size]
+constexpr int pst[Types_size][gameStageSize][Player_size][Board_size]
 {
 	// Pawns.
 	{
@@ -387,15 +384,30 @@ const int outpost[gameStageSize][Player_size][Board_size]
 	}
 };
 
-inline int getScore(PieceType p, GameStage g, Color c, Square s)
+// The table above with both game stages packed into one Score, built when
+// compiling.
+struct PackedTable
+{
+	constexpr PackedTable() : score{}
+	{
+		for (int p = 0; p < Types_size; ++p)
+			for (int c = 0; c < Player_size; ++c)
+				for (int s = 0; s < Board_size; ++s)
+					score[p][c][s] = make_score(pst[p][middle][c][s], pst[p][late][c][s]);
+	}
+	Score score[Types_size][Player_size][Board_size];
+};
+
+constexpr PackedTable packed;
+
+inline Score getScore(PieceType p, Color c, Square s)
 {
-	return pst[p][g][c][s];
+	return packed.score[p][c][s];
 }
 
-inline int iScore(float phase, PieceType p, Color c, Square s)
+inline int iScore(int phase, PieceType p, Color c, Square s)
 {
-	return ((pst[p][middle][c][s] * (256 - phase)) + pst[p][late][c][s] * 
-		   phase) / 256;
+	return taper(packed.score[p][c][s], phase);
 }
 
 }
@@ -1,26 +1,58 @@
 #include "search.h"
 #include "misc.h"
 #include <fstream>
+#include <memory>
+#include <thread>
 
-LineManager lineManager;
-History history;
+int threadCount = 1;
+int pawnHashSize = Default_pawn_size;
+bool useEvalCache = true;
 
-bool interrupt(SearchInfo& si)
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Lazy SMP. Helper threads run their own iterative deepening on a copy of    //
+// the root and communicate only through the transposition table. To keep the //
+// helpers from all searching the same tree, each one skips a different set   //
+// of depths (skip pattern from Stockfish).                                   //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+static const int SkipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+static const int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+static std::atomic<bool> stopSearch;
+static std::vector<std::unique_ptr<SearchThread>> threads;
+static std::vector<std::thread> helpers;
+
+bool interrupt(SearchThread& t, SearchInfo& si)
 {
+    if (t.stop && t.stop->load(std::memory_order_relaxed))
+    {
+        si.quit = true;
+        return true;
+    }
+
+    // Only the main thread watches the clock and the GUI.
+    if (t.id != 0)
+        return false;
+
     // Check to see if we have run out of time.
     if (si.clock.elapsed<std::chrono::milliseconds>() >= si.moveTime
         && !si.infinite)
     {
         si.quit = true;
+        if (t.stop)
+            *t.stop = true;
         return true;
     }
 
-    if (input_waiting())
+    if (!si.silent && input_waiting())
     {
         std::string command(get_input());
         if (command == "quit" || command == "stop")
         {
             si.quit = true;
+            if (t.stop)
+                *t.stop = true;
             return true;
         }
     }
@@ -30,19 +62,48 @@ bool interrupt(SearchInfo& si)
     return false;
 }
 
-int qsearch(State& s, SearchInfo& si, int ply, int alpha, int beta)
+// Static evaluation of s, looked up in the thread's eval cache first unless
+// the cache is switched off. The network is used when it is switched on. Given
+// a window the classical eval may exit early with a bound outside of it, which
+// is not cached.
+static int static_eval(SearchThread& t, const State& s, const MaterialEntry& material,
+                       int alpha = Neg_inf, int beta = Pos_inf)
 {
-    si.nodes++;
+    int score;
+    if (useEvalCache && t.evalCache.probe(s.getKey(), score))
+        return score;
+
+    if (NNUE::enabled)
+        score = NNUE::evaluate(s);
+    else
+    {
+        Evaluate evaluate(s, t.pawnHash, material, alpha, beta);
+        score = evaluate.getScore();
+        ++t.evals;
+        if (evaluate.isLazy())
+        {
+            ++t.lazyEvals;
+            return score;
+        }
+    }
+    if (useEvalCache)
+        t.evalCache.store(s.getKey(), score);
+    return score;
+}
+
+int qsearch(SearchThread& t, State& s, SearchInfo& si, int ply, int alpha, int beta)
+{
+    t.addNode();
     assert(ply < Max_ply);
 
-    if (history.isThreefoldRepetition(s) ||
-        s.insufficientMaterial() ||
+    const MaterialEntry* material = t.materialHash.probe(s);
+
+    if (t.history.isThreefoldRepetition(s) ||
+        material->isDraw(s) ||
         s.getFiftyMoveRule() > 99)
         return Draw;
 
-    Evaluate evaluate(s);
-
-    int qscore = evaluate.getScore();
+    int qscore = static_eval(t, s, *material, alpha, beta);
 
     // If a beta cutoff is found, return the qscore.
     if (qscore >= beta)
@@ -52,7 +113,7 @@ int qsearch(State& s, SearchInfo& si, int ply, int alpha, int beta)
     alpha = std::max(alpha, qscore);
 
     // Generate moves and create the movelist.
-    MoveList mlist(s, nullMove, &history, ply, true);
+    MoveList mlist(s, nullMove, &t.history, ply, true);
 
     int bestScore = Neg_inf;
     int score;
@@ -89,12 +150,23 @@ int qsearch(State& s, SearchInfo& si, int ply, int alpha, int beta)
             }
         }
 
+        // See scout_search for the two make schemes.
+#if defined(MAKE_UNMAKE)
+        Undo undo;
+        s.make(m, undo);
+        State& c = s;
+#else
         State c(s);
         c.make_t(m);
-
-        history.push(std::make_pair(m, c.getKey()));
-        score = -qsearch(c, si, ply + 1, -beta, -alpha);
-        history.pop();
+#endif
+        t.pawnHash.prefetch(c.getPawnKey());
+
+        t.history.push(std::make_pair(m, c.getKey()));
+        score = -qsearch(t, c, si, ply + 1, -beta, -alpha);
+        t.history.pop();
+#if defined(MAKE_UNMAKE)
+        s.unmake(m, undo);
+#endif
         if (score >= bestScore)
             bestScore = score;
 
@@ -110,66 +182,84 @@ int qsearch(State& s, SearchInfo& si, int ply, int alpha, int beta)
     return alpha;                                // Fail-Hard alpha beta score.
 }
 
-int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int beta, bool isPv, bool isNull, bool isRoot)
+int scout_search(SearchThread& t, State& s, SearchInfo& si, int depth, int ply, int alpha, int beta, bool isPv, bool isNull, bool isRoot)
 {
     assert(depth >= 0);
     Move best_move = nullMove;
     
-    if (si.quit || (si.nodes % 3000 == 0 && interrupt(si)))
+    if (si.quit || (t.getNodes() % 3000 == 0 && interrupt(t, si)))
         return 0;
 
-    si.nodes++;
+    t.addNode();
 
     // Evaluate leaf nodes.
     if (depth == 0)
-        return qsearch(s, si, ply, alpha, beta);
+        return qsearch(t, s, si, ply, alpha, beta);
+
+    const MaterialEntry* material = t.materialHash.probe(s);
 
     // Check for draw.
     if (!isRoot && 
-        (history.isThreefoldRepetition(s) ||
-        s.insufficientMaterial() || 
+        (t.history.isThreefoldRepetition(s) ||
+        material->isDraw(s) || 
         s.getFiftyMoveRule() > 99))
         return Draw;
 
-    // Get a pointer to the correction transposition table location.
-    const TableEntry* table_entry = ttable.probe(s.getKey());
+    // Look up the position in the transposition table.
+    TableEntry table_entry;
+    bool ttHit = t.ttable.probe(s.getKey(), table_entry, &t.tableStats);
 
-    // Check if table entry is valid and matches the position key.
-    if (table_entry->key == s.getKey() && table_entry->depth >= depth)
+    // Check if the table entry is deep enough to use. Never cut at the root,
+    // a helper thread may have already stored a deeper result there and we
+    // still need a pv for this iteration.
+    if (!isRoot && ttHit && table_entry.depth >= depth)
     {
-        if (table_entry->type == pv)             // PV Node, return the score.
-            return table_entry->score;
-        else if (table_entry->type == cut)       // Cut Node, adjust alpha.
+        if (table_entry.type == pv)              // PV Node, return the score.
+        {
+            ++t.tableStats.cutoffs;
+            return table_entry.score;
+        }
+        else if (table_entry.type == cut)        // Cut Node, adjust alpha.
         {
-            if (table_entry->score >= beta)
+            if (table_entry.score >= beta)
+            {
+                ++t.tableStats.cutoffs;
                 return beta;
+            }
         }
         else
         {
-            if (table_entry->score <= alpha)
+            if (table_entry.score <= alpha)
+            {
+                ++t.tableStats.cutoffs;
                 return alpha;
+            }
         }
 
-        best_move = table_entry->best;
+        best_move = table_entry.best;
     }
 
     // Check if we are at the PV line.
-    if (lineManager.getPvKey(ply) == s.getKey())
+    if (t.lineManager.getPvKey(ply) == s.getKey())
     {
-        best_move = lineManager.getPvMove(ply);
+        best_move = t.lineManager.getPvMove(ply);
     }
 
 // -------------------------------------------------------------------------- //
 //                                                                            //
 // Static Evaluation. Evaluate the current position statically if the         //
-// current node is not a PV node.                                             //
+// current node is not a PV node. The transposition table keeps the static    //
+// eval of the position, so reuse it when we have one, otherwise try the eval //
+// cache.                                                                     //
 //                                                                            //
 // -------------------------------------------------------------------------- //
     int staticEval = 0;
     if (!isPv)
     {
-        Evaluate evaluate(s);
-        staticEval = evaluate.getScore();
+        if (ttHit && table_entry.eval != No_eval)
+            staticEval = table_entry.eval;
+        else
+            staticEval = static_eval(t, s, *material);
     }
 
 // -------------------------------------------------------------------------- //
@@ -202,12 +292,20 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
     if (!isPv && !isNull && !s.inCheck() && depth > NullMoveDepth 
         && s.getNonPawnPieceCount(s.getOurColor()) > NullMoveCount)
     {
-        State n;
-        std::memmove(&n, &s, sizeof s);
+#if defined(MAKE_UNMAKE)
+        Undo undo;
+        s.makeNull(undo);
+        State& n = s;
+#else
+        State n(s);
         n.makeNull();
-        history.push(std::make_pair(nullMove, n.getKey()));
-        int nullScore = -scout_search(n, si, depth - 3, ply + 1, -(alpha + 1), -alpha, false, true, false);
-        history.pop();
+#endif
+        t.history.push(std::make_pair(nullMove, n.getKey()));
+        int nullScore = -scout_search(t, n, si, depth - 3, ply + 1, -(alpha + 1), -alpha, false, true, false);
+        t.history.pop();
+#if defined(MAKE_UNMAKE)
+        s.unmakeNull(undo);
+#endif
         if (nullScore >= beta)
             return beta;
     }
@@ -218,13 +316,12 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
     {
         // Using depth calculation from Stockfish.
         int d = 3 * depth / 4 - 2;
-        scout_search(s, si, d, ply, alpha, beta, isPv, true, false);
-        table_entry = ttable.probe(s.getKey());
-        if (table_entry->key == s.getKey())
-            best_move = table_entry->best;
+        scout_search(t, s, si, d, ply, alpha, beta, isPv, true, false);
+        if (t.ttable.probe(s.getKey(), table_entry))
+            best_move = table_entry.best;
     }
     // Generate moves and create the movelist.
-    MoveList mlist(s, best_move, &history, ply);
+    MoveList mlist(s, best_move, &t.history, ply);
 
     int a = alpha;
     int b = beta;
@@ -278,15 +375,36 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
 // prune the move. The calculation I'm currently using is:                    //
 //   see(move) < -pawn * 2^(depth - 1)                                        //
 //                                                                            //
+// Only the comparison matters, so seeGe stops as soon as it is decided.      //
+//                                                                            //
 // -------------------------------------------------------------------------- //
             if (depth < 3 &&
-                s.see(m) < -Pawn_wt * (1 << (depth - 1)))
+                !s.seeGe(m, -Pawn_wt * (1 << (depth - 1))))
                 continue;
         }
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Children are copies of their parent State unless the engine is built with  //
+// MAKE_UNMAKE defined (make unmake). Then the move is made on the parent     //
+// itself and taken back with an Undo record kept on the stack. Between the   //
+// two the parent is the child, so anything needed about the parent, like     //
+// whether it is in check or the move is a capture, is read before the make.  //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+        const bool inCheck = s.inCheck();
+        const bool capture = s.isCapture(m);
+#if defined(MAKE_UNMAKE)
+        Undo undo;
+        s.make(m, undo);                             // Make move.
+        State& c = s;
+#else
         State c(s);
         c.make_t(m);                                 // Make move.
-        history.push(std::make_pair(m, c.getKey())); // Add move to gamelist.
+#endif
+        t.ttable.prefetch(c.getKey());               // Child probes these
+        t.pawnHash.prefetch(c.getPawnKey());         // first thing.
+        t.history.push(std::make_pair(m, c.getKey())); // Add move to gamelist.
         count++;
 
         if (c.inCheck() && depth == 1)
@@ -298,7 +416,7 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
             // Set the best move to the first move just in case no move
             // improves alpha.
             best_move = m;
-            score = -scout_search(c, si, d, ply + 1, -b, -a, isPv, isNull, false);
+            score = -scout_search(t, c, si, d, ply + 1, -b, -a, isPv, isNull, false);
             first = false;
         }       
         else
@@ -315,23 +433,26 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
 //   6. The move does not capture a piece.                                    //
 //                                                                            //
 // -------------------------------------------------------------------------- //
-            if (count > LmrCount && depth > LmrDepth && !isPv && !s.inCheck()
-                && !c.inCheck() && !s.isCapture(m) && !isPromotion(m))
-                score = -scout_search(c, si, d - 1, ply + 1, -(a + 1), -a, false, isNull, false);
+            if (count > LmrCount && depth > LmrDepth && !isPv && !inCheck
+                && !c.inCheck() && !capture && !isPromotion(m))
+                score = -scout_search(t, c, si, d - 1, ply + 1, -(a + 1), -a, false, isNull, false);
             else
                 score = a + 1;
 
             if (score > a)
-                score = -scout_search(c, si, d, ply + 1, -(a + 1), -a, false, isNull, false);
+                score = -scout_search(t, c, si, d, ply + 1, -(a + 1), -a, false, isNull, false);
 
             // If an alpha improvement caused fail high, research using a full window.
             if (a < score && b > score)
             {
-                score = -scout_search(c, si, d, ply + 1, -b, -a, true, isNull, false);
+                score = -scout_search(t, c, si, d, ply + 1, -b, -a, true, isNull, false);
             }
         }
 
-        history.pop();                           // Remove move from gamelist.
+        t.history.pop();                         // Remove move from gamelist.
+#if defined(MAKE_UNMAKE)
+        s.unmake(m, undo);                       // Take the move back.
+#endif
 
         if (score > bestScore)
         {
@@ -347,13 +468,13 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
         {
             a = b;
             if (s.isQuiet(m))
-                history.update(m, depth, ply, true);
+                t.history.update(m, depth, ply, true);
             break;
         }
         else
         {
             if (s.isQuiet(m))
-                history.update(m, depth, ply, false);
+                t.history.update(m, depth, ply, false);
         }
     }
 
@@ -362,17 +483,66 @@ int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int be
 
     if (a > alpha && a < b && !si.quit)
     {
-        lineManager.pushToPv(best_move, s.getKey(), ply, a);
+        t.lineManager.pushToPv(best_move, s.getKey(), ply, a);
     }
 
-    ttable.store(s.getKey(), best_move, a <= alpha ? all : a >= b ? cut : pv, depth, a);
+    t.ttable.store(s.getKey(), best_move, a <= alpha ? all : a >= b ? cut : pv, depth, a,
+                   isPv ? No_eval : staticEval, &t.tableStats);
 
     // Fail-Hard alpha beta score.
     return a;
 
 }
 
-void iterative_deepening(State& s, SearchInfo& si)
+uint64_t total_nodes()
+{
+    uint64_t nodes = 0;
+    for (const std::unique_ptr<SearchThread>& t : threads)
+        nodes += t->getNodes();
+    return nodes;
+}
+
+TableStats table_stats()
+{
+    TableStats stats;
+    for (const std::unique_ptr<SearchThread>& t : threads)
+        stats += t->tableStats;
+    return stats;
+}
+
+// The pawn hash and eval cache are kept between moves, like the hash table.
+// Both are cleared on ucinewgame and when the evaluation changes, a resize
+// of the pawn hash starts it empty.
+void clear_caches()
+{
+    for (std::unique_ptr<SearchThread>& t : threads)
+    {
+        t->pawnHash.clear();
+        t->evalCache.clear();
+    }
+}
+
+void eval_cache_stats(uint64_t& probes, uint64_t& hits)
+{
+    probes = hits = 0;
+    for (const std::unique_ptr<SearchThread>& t : threads)
+    {
+        probes += t->evalCache.getProbes();
+        hits += t->evalCache.getHits();
+    }
+}
+
+void lazy_eval_stats(uint64_t& evals, uint64_t& lazy)
+{
+    evals = lazy = 0;
+    for (const std::unique_ptr<SearchThread>& t : threads)
+    {
+        evals += t->evals;
+        lazy += t->lazyEvals;
+    }
+}
+
+Move iterative_deepening(SearchThread& t, State& s, SearchInfo& si)
 {
     int score;
     // Iterative deepening.
@@ -381,67 +551,114 @@ void iterative_deepening(State& s, SearchInfo& si)
         if (d == si.depth)
             break;
 
-        score = scout_search(s, si, d, 0, Neg_inf, Pos_inf, true, false, true);
+        uint64_t startNodes = t.getNodes();
 
-        if (lineManager.getPvMove() == nullMove)
-        {
-            std::cout << "bestmove 0000" << std::endl;
-            return;
-        }
+        score = scout_search(t, s, si, d, 0, Neg_inf, Pos_inf, true, false, true);
+
+        if (t.lineManager.getPvMove() == nullMove)
+            return nullMove;
 
         if (si.quit)
             break;
 
         // Confirm all the pv moves are legal.
-        lineManager.checkPv(s);
+        t.lineManager.checkPv(s);
 
         // Print info to gui.
-        std::cout << "info "
-                  << "depth " << d;
-
-        if (lineManager.isMate())
+        if (!si.silent)
         {
-            int n = lineManager.getMateInN();
-            std::cout << " score mate " << (score > 0 ? n : -n);
-        }
-        else
-        {
-            std::cout << " score cp " << score;
-        }
+            uint64_t nodes = total_nodes();
+            int64_t elapsed = si.clock.elapsed<std::chrono::milliseconds>();
 
-        std::cout << " time " 
-                  << si.clock.elapsed<std::chrono::milliseconds>()
-                  << " nodes " 
-                  << si.nodes
-                  << " nps " 
-                  << si.nodes / (si.clock.elapsed<std::chrono::milliseconds>() + 1) * 1000;
-        lineManager.printPv();
-        std::cout << std::endl;
+            std::cout << "info "
+                      << "depth " << d;
+
+            if (t.lineManager.isMate())
+            {
+                int n = t.lineManager.getMateInN();
+                std::cout << " score mate " << (score > 0 ? n : -n);
+            }
+            else
+            {
+                std::cout << " score cp " << score;
+            }
+
+            std::cout << " time " << elapsed
+                      << " nodes " << nodes
+                      << " nps " << nodes * 1000 / (elapsed + 1)
+                      << " hashfull " << t.ttable.hashfull();
+            t.lineManager.printPv();
+            std::cout << std::endl;
+        }
 
         // This check handles the case where the search tree was the same
         // exact size as the previous depth (can occur for a forced draw
-        // or mating sequence).
-        if (si.nodes == si.prevNodes)
+        // or mating sequence). A warm hash table can also cut every root
+        // move for a few iterations, so only trust it for mate and draw
+        // scores.
+        if (t.getNodes() - startNodes == si.prevNodes
+            && (t.lineManager.isMate() || score == Draw))
             break;
 
         // Break if there's not enough time for the next search.
         if (si.clock.elapsed<std::chrono::milliseconds>() * 2 > si.moveTime)
             break;
 
-        // Reset node count.
-        si.prevNodes = si.nodes;
-        si.nodes = 0;
+        si.prevNodes = t.getNodes() - startNodes;
     }
 
-    std::cout << "bestmove " << toString(lineManager.getPvMove()) << std::endl;
+    return t.lineManager.getPvMove();
+}
+
+void helper_search(SearchThread* t, State s, SearchInfo si)
+{
+    const int i = (t->id - 1) % 20;
+
+    for (int d = 1; !si.quit && d < si.depth; ++d)
+    {
+        if (((d + SkipPhase[i]) / SkipSize[i]) % 2)
+            continue;
+
+        scout_search(*t, s, si, d, 0, Neg_inf, Pos_inf, true, false, true);
+    }
 }
 
-void setup_search(State& s, SearchInfo& si)
+void setup_search(State& s, SearchInfo& si, const History& game)
 {
-    //ttable.setAncient();
-    ttable.clear();
-    lineManager.clearPv();
-    init_eval();
-    history.clear();
-    iterative_deepening(s, si);
-}
\ No newline at end of file
+    // Threads are created on the first search after the Threads option
+    // changes and reused after that.
+    while (static_cast<int>(threads.size()) < threadCount)
+        threads.emplace_back(new SearchThread(threads.size(), ttable));
+    threads.resize(threadCount);
+
+    // The table is kept between moves, only ucinewgame clears it.
+    ttable.newSearch();
+
+    // The root may have been set up before the network was switched on.
+    if (NNUE::enabled)
+        s.refreshAccumulator(true);
+
+    for (std::unique_ptr<SearchThread>& t : threads)
+    {
+        t->history = game;
+        t->pawnHash.resize(pawnHashSize);
+        t->clear();
+        t->stop = &stopSearch;
+    }
+
+    stopSearch = false;
+    for (int i = 1; i < threadCount; ++i)
+        helpers.push_back(std::thread(helper_search, threads[i].get(), s, si));
+
+    Move best = iterative_deepening(*threads[0], s, si);
+
+    // The main thread is done. Stop the helpers before reporting the move.
+    stopSearch = true;
+    for (std::thread& helper : helpers)
+        helper.join();
+    helpers.clear();
+
+    if (!si.silent)
+        std::cout << "bestmove " << (best == nullMove ? "0000" : toString(best))
+                  << std::endl;
+}
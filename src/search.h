@@ -2,11 +2,13 @@
 #define SEARCH_H
 
 #include <algorithm>
+#include <atomic>
 #include <stack>
 #include <sstream>
 #include <string>
 #include <vector>
 #include "evaluation.h"
+#include "eval_cache.h"
 #include "move_generator.h"
 #include "state.h"
 #include "types.h"
@@ -20,6 +22,7 @@ static const int LmrCount = 3;
 static const int LmrDepth = 2;
 static const int NullMoveCount = 3;
 static const int NullMoveDepth = 3;
+static const int Max_threads = 64;
 
 enum SearchType
 {
@@ -30,28 +33,83 @@ enum SearchType
 struct SearchInfo
 {
     SearchInfo() 
-    : moveTime(0)
-    , nodes(0)
-    , prevNodes(0)
+    : time{}
+    , inc{}
     , moves_to_go(0)
-    , quit(false)
-    , infinite(false)
     , depth(Max_ply)
-    , time{}
-    , inc{}
+    , prevNodes(0)
+    , moveTime(0)
+    , infinite(false)
+    , quit(false)
+    , silent(false)
     {}
     int time[Player_size], inc[Player_size];
-    int moves_to_go, depth, max_nodes, nodes, prevNodes, mate;
+    int moves_to_go, depth, max_nodes, mate;
+    uint64_t prevNodes;
     int64_t moveTime;
     Clock clock;
     bool infinite, ponder, quit;
+    bool silent;                                 // No gui output or input.
     std::vector<Move> sm;
 };
 
-extern History history;
-extern LineManager lineManager;
-void setup_search(State& s, SearchInfo& si);
-void iterative_deepening(State& s, SearchInfo& si);
-int scout_search(State& s, SearchInfo& si, int depth, int ply, int alpha, int beta, bool isPv, bool isNull, bool isRoot);
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Everything a single search thread writes to while searching: killers,      //
+// history tables, the pv, the game history stack, the pawn, material and     //
+// eval caches and the node and hash counters. Threads never touch each       //
+// other's contexts, so two searches can run side by side. The transposition  //
+// table is shared by reference.                                              //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct SearchThread
+{
+    SearchThread(int pId, TranspositionTable& pTable)
+    : id(pId), ttable(pTable), stop(nullptr), evals(0), lazyEvals(0), nodes(0)
+    {}
+    void clear()
+    {
+        history.clear();
+        lineManager.clearPv();
+        evalCache.clearStats();
+        tableStats = TableStats();
+        evals = lazyEvals = 0;
+        nodes = 0;
+    }
+    // Only the owning thread increments the counter, so a relaxed load and
+    // store is enough and avoids a locked add on every node.
+    void addNode()
+    {
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+    uint64_t getNodes() const
+    {
+        return nodes.load(std::memory_order_relaxed);
+    }
+    int id;                                      // 0 is the main thread.
+    TranspositionTable& ttable;
+    std::atomic<bool>* stop;                     // Shared stop signal.
+    History history;
+    LineManager lineManager;
+    PawnHash pawnHash;
+    MaterialHash materialHash;
+    EvalCache evalCache;
+    TableStats tableStats;
+    uint64_t evals, lazyEvals;                   // Classical evals, lazy exits.
+    std::atomic<uint64_t> nodes;
+};
+
+extern int threadCount;
+extern int pawnHashSize;
+extern bool useEvalCache;
+void setup_search(State& s, SearchInfo& si, const History& game);
+Move iterative_deepening(SearchThread& t, State& s, SearchInfo& si);
+void clear_caches();
+uint64_t total_nodes();
+TableStats table_stats();
+void eval_cache_stats(uint64_t& probes, uint64_t& hits);
+void lazy_eval_stats(uint64_t& evals, uint64_t& lazy);
+int scout_search(SearchThread& t, State& s, SearchInfo& si, int depth, int ply, int alpha, int beta, bool isPv, bool isNull, bool isRoot);
 
 #endif  
\ No newline at end of file
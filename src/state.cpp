@@ -9,44 +9,52 @@
 State::State(const State & s)
 : mUs(s.mUs)
 , mThem(s.mThem)
-, mFiftyMoveRule(s.mFiftyMoveRule)
 , mCastleRights(s.mCastleRights)
 , mPhase(s.mPhase)
-, mKey(s.mKey)
-, mPawnKey(s.mPawnKey)
-, mCheckers(s.mCheckers)
+, mFiftyMoveRule(s.mFiftyMoveRule)
 , mEnPassant(s.mEnPassant)
-, mCheckSquares(s.mCheckSquares)
-, mPinned(s.mPinned)
+, mCheckers(s.mCheckers)
 , mOccupancy(s.mOccupancy)
-, mPieceIndex(s.mPieceIndex)
+, mPinned(s.mPinned)
+, mKey(s.mKey)
+, mPieces(s.mPieces)
 , mBoard(s.mBoard)
+, mCheckSquares(s.mCheckSquares)
+, mPawnKey(s.mPawnKey)
+, mMaterialKey(s.mMaterialKey)
 , mPstScore(s.mPstScore)
-, mPieces(s.mPieces)
 , mPieceCount(s.mPieceCount)
+, mPieceIndex(s.mPieceIndex)
 , mPieceList(s.mPieceList)
-{}
+{
+    // The accumulators are a kilobyte, only copy them when they are used.
+    if (NNUE::enabled)
+        mAccumulator = s.mAccumulator;
+}
 
 void State::operator=(const State & s)
 {
     mUs = s.mUs;
     mThem = s.mThem;
-    mFiftyMoveRule = s.mFiftyMoveRule;
     mCastleRights = s.mCastleRights;
     mPhase = s.mPhase;
-    mKey = s.mKey;
-    mPawnKey = s.mPawnKey;
-    mCheckers = s.mCheckers;
+    mFiftyMoveRule = s.mFiftyMoveRule;
     mEnPassant = s.mEnPassant;
-    mCheckSquares = s.mCheckSquares;
-    mPinned = s.mPinned;
+    mCheckers = s.mCheckers;
     mOccupancy = s.mOccupancy;
-    mPieceIndex = s.mPieceIndex;
-    mBoard = s.mBoard;
+    mPinned = s.mPinned;
+    mKey = s.mKey;
     mPieces = s.mPieces;
-    mPieceCount = s.mPieceCount;
+    mBoard = s.mBoard;
+    mCheckSquares = s.mCheckSquares;
+    mPawnKey = s.mPawnKey;
+    mMaterialKey = s.mMaterialKey;
     mPstScore = s.mPstScore;
+    mPieceCount = s.mPieceCount;
+    mPieceIndex = s.mPieceIndex;
     mPieceList = s.mPieceList;
+    if (NNUE::enabled)
+        mAccumulator = s.mAccumulator;
 }
 
 // ---------------------------------------------------------------------------- //
@@ -144,6 +152,9 @@ State::State(const std::string & fen)
 
     // Initialize game phase.
     setGamePhase();
+
+    if (NNUE::enabled)
+        refreshAccumulator();
 }
 
 void State::init()
@@ -154,6 +165,7 @@ void State::init()
     mCastleRights = 0;
     mKey = 0;
     mPawnKey = 0;
+    mMaterialKey = 0;
     mCheckers = 0;
     mEnPassant = 0;
     mCheckSquares.fill({});
@@ -167,17 +179,17 @@ void State::init()
     for (auto i = mPieceList.begin(); i != mPieceList.end(); ++i)
         for (auto j = i->begin(); j != i->end(); ++j)
             j->fill(no_sq);
+    mAccumulator.dirty[white] = mAccumulator.dirty[black] = true;
 }
 
 // ----------------------------------------------------------------------------
 // Function to return a bitboard of all pinned pieces for the current player.
 // ----------------------------------------------------------------------------
 
-void State::setPins(Color c)
+U64 State::findPins(Color c) const
 {
-    U64 pinners, ray;
+    U64 pinners, ray, pinned = 0;
     Square kingSq = getKingSquare(c);
-    mPinned[c] = 0;
 
     pinners = bishopMoves[kingSq] & (getPieceBB<bishop>(!c) | getPieceBB<queen>(!c));
 
@@ -185,7 +197,7 @@ void State::setPins(Color c)
     {
         ray = between_dia[pop_lsb(pinners)][kingSq] & getOccupancyBB();
         if (pop_count(ray) == 1)
-            mPinned[c] |= ray & getOccupancyBB(c);
+            pinned |= ray & getOccupancyBB(c);
     }
 
     pinners = rookMoves[kingSq] & (getPieceBB<rook>(!c) | getPieceBB<queen>(!c));
@@ -194,8 +206,24 @@ void State::setPins(Color c)
     {
         ray = between_hor[pop_lsb(pinners)][kingSq] & getOccupancyBB();
         if (pop_count(ray) == 1)
-            mPinned[c] |= ray & getOccupancyBB(c);
+            pinned |= ray & getOccupancyBB(c);
     }
+
+    return pinned;
+}
+
+void State::setPins(Color c)
+{
+    mPinned[c] = findPins(c);
+}
+
+// Whether the checkers and pins kept up by make_t match a recomputation from
+// scratch. Used by the debug perft.
+bool State::checkersAndPinsValid() const
+{
+    return mCheckers == getAttackersBB(getKingSquare(mUs), mThem)
+        && mPinned[white] == findPins(white)
+        && mPinned[black] == findPins(black);
 }
 
 U64 State::getDiscoveredChecks(Color c) const
@@ -224,6 +252,36 @@ U64 State::getDiscoveredChecks(Color c) const
     return discover;
 }
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Every square attacked by color c, with sliders looking through pOcc. The   //
+// move generator passes the occupancy without our king, so a king stepping   //
+// back along a checking ray is still seen as attacked.                       //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+U64 State::getThreatsBB(Color c, U64 pOcc) const
+{
+    U64 pieces, threats;
+
+    pieces = getPieceBB<pawn>(c);
+    threats = c == white ? (pieces & Not_a_file) << 9 | (pieces & Not_h_file) << 7
+                         : (pieces & Not_a_file) >> 7 | (pieces & Not_h_file) >> 9;
+
+    pieces = getPieceBB<knight>(c);
+    while (pieces)
+        threats |= Knight_moves[pop_lsb(pieces)];
+
+    pieces = getPieceBB<bishop>(c) | getPieceBB<queen>(c);
+    while (pieces)
+        threats |= bishop_attacks(pop_lsb(pieces), pOcc);
+
+    pieces = getPieceBB<rook>(c) | getPieceBB<queen>(c);
+    while (pieces)
+        threats |= rook_attacks(pop_lsb(pieces), pOcc);
+
+    return threats | King_moves[getKingSquare(c)];
+}
+
 bool State::isLegal(Move pMove) const
 {
     Square src = getSrc(pMove);
@@ -516,10 +574,6 @@ int State::see(Move m) const
         // Storing the potential gain, if defended.
         gain[d] = PieceValue[target] - gain[d - 1];
 
-        // Prune if the gain cannot be improved.
-        if (std::max(-gain[d - 1], gain[d]) < 0)
-            break;
-
         // Remove the from bit to simulate making the move.
         attackers ^= from;
         occupancy ^= from;
@@ -529,8 +583,9 @@ int State::see(Move m) const
         if (target != knight)
         {
             xRay &= occupancy;
-            // Create a bitboard of potential discovered attackers.
-            potential = coplanar[src][dst] & xRay;
+            // Create a bitboard of potential discovered attackers. Sliders
+            // already attacking from the far side of dst are not new.
+            potential = coplanar[src][dst] & xRay & ~attackers;
             while (potential)
             {
                 mayAttack = pop_lsb(potential);
@@ -575,6 +630,107 @@ int State::see(Move m) const
     return gain[0];
 }
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Whether see(m) >= threshold, without building the gain array. The same    //
+// exchange is played out, but after each capture we only ask whether the     //
+// side that just captured can stop there and already be on the right side of //
+// the threshold. Swap holds how far the last capture is from being enough    //
+// for the side that made it. Either side may stop capturing, so as soon as   //
+// the side to recapture gains nothing by doing so, the answer is known.      //
+//                                                                            //
+// Values match see(): en passant wins a pawn, a queen promotion wins the     //
+// promotion, and the king only recaptures if nothing attacks it afterwards.  //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+bool State::seeGe(Move m, int threshold) const
+{
+    Color color;
+    Square src, dst, mayAttack;
+    PieceType target;
+    U64 attackers, from, occupancy, xRay, potential;
+    int swap;
+    bool result;
+
+    src = getSrc(m);
+    dst = getDst(m);
+    target = onSquare(src);
+
+    // What the capture wins if nothing recaptures.
+    if (target == pawn && square_bb[dst] & mEnPassant)
+        swap = PieceValue[pawn] - threshold;
+    else if (getPiecePromo(m) == queen)
+        swap = Queen_wt - Pawn_wt - threshold;
+    else
+        swap = PieceValue[onSquare(dst)] - threshold;
+    if (swap < 0)
+        return false;
+
+    // What is left if the capturing piece is lost in return.
+    swap = PieceValue[target] - swap;
+    if (swap <= 0)
+        return true;
+
+    color = mUs;
+    result = true;
+    from = square_bb[src];
+    occupancy = getOccupancyBB();
+    attackers = allAttackers(dst);
+    xRay = getXRayAttacks(dst);
+
+    while (true)
+    {
+        // Remove the from bit to simulate making the move, and add any
+        // slider it uncovers behind it.
+        attackers ^= from;
+        occupancy ^= from;
+        if (target != knight)
+        {
+            xRay &= occupancy;
+            potential = coplanar[src][dst] & xRay & ~attackers;
+            while (potential)
+            {
+                mayAttack = pop_lsb(potential);
+                if (!(between[mayAttack][dst] & occupancy))
+                {
+                    attackers |= square_bb[mayAttack];
+                    break;
+                }
+            }
+        }
+
+        // The other side recaptures with its least valuable attacker.
+        color = !color;
+        if (!(attackers & getOccupancyBB(color)))
+            break;
+
+        if (attackers & getPieceBB<pawn>(color))
+            target = pawn;
+        else if (attackers & getPieceBB<knight>(color))
+            target = knight;
+        else if (attackers & getPieceBB<bishop>(color))
+            target = bishop;
+        else if (attackers & getPieceBB<rook>(color))
+            target = rook;
+        else if (attackers & getPieceBB<queen>(color))
+            target = queen;
+        else
+            target = king;
+        from = get_lsb_bb(attackers & mPieces[color][target]);
+        src = get_lsb(from);
+
+        if (target == king)
+            return (attackers & getOccupancyBB(!color)) ? result : !result;
+
+        result = !result;
+        swap = PieceValue[target] - swap;
+        if (swap < result)
+            break;
+    }
+
+    return result;
+}
+
 // ----------------------------------------------------------------------------
 // Make move function responsible for updating the state based on the source, 
 // destination, and type of move.
@@ -587,6 +743,7 @@ void State::make_t(Move pMove)
     assert(getDst(pMove) < no_sq);
     Square src, dst;
     PieceType moved, captured;
+    U64 vacated, occupied, direct;
     bool epFlag = false;
     bool gamePhase = false;
 
@@ -598,6 +755,14 @@ void State::make_t(Move pMove)
     captured = onSquare(dst);
     assert(captured != king);
 
+    // Squares the move empties and fills, and whether the piece landing on
+    // dst attacks their king. mCheckSquares still holds the squares that
+    // attack their king, as seen before the move.
+    vacated = square_bb[src];
+    occupied = square_bb[dst];
+    direct = mCheckSquares[getPiecePromo(pMove) ? getPiecePromo(pMove) : moved]
+           & square_bb[dst];
+
     // Update the Fifty Move Rule
     mFiftyMoveRule++;
 
@@ -623,13 +788,18 @@ void State::make_t(Move pMove)
         {
             movePiece(mUs, rook, src-3, dst+1);
             movePiece(mUs, king, src, dst);
+            vacated |= square_bb[src-3];
+            occupied |= square_bb[dst+1];
         }
         // Queenside Castle
         else
         {
             movePiece(mUs, rook, src+4, dst-1);
             movePiece(mUs, king, src, dst);
+            vacated |= square_bb[src+4];
+            occupied |= square_bb[dst-1];
         }
+        direct = mCheckSquares[rook] & occupied;
     }
     else
         movePiece(mUs, moved, src, dst);
@@ -660,6 +830,7 @@ void State::make_t(Move pMove)
             Square epCapture = (mUs == white) ? dst - 8 : dst + 8;
             mPawnKey ^= Zobrist::key(mThem, pawn, epCapture);
             removePiece(mThem, pawn, epCapture);
+            vacated |= square_bb[epCapture];
             gamePhase = true;
         }
     }
@@ -680,9 +851,46 @@ void State::make_t(Move pMove)
     assert((mEnPassant & getOccupancyBB()) == 0);
     swapTurn();
 
-    setPins(white);
-    setPins(black);
-    setCheckers();
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Most moves are nowhere near either king, so rather than recomputing the    //
+// checkers and pins every move, work out whether this one can change them.   //
+//                                                                            //
+// We were not in check before the move, so the side to move now is in check  //
+// only if the piece that landed attacks the king directly, or a square the   //
+// move emptied lies on a line from the king and uncovers a slider. A piece   //
+// landing on a line can only block, and there was nothing to block.          //
+//                                                                            //
+// The pins of either side can only change if its king moved, or if a square  //
+// the move emptied or filled lies on a line from that king.                  //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+    Square k = getKingSquare(mUs);
+    if (direct || vacated & (bishopMoves[k] | rookMoves[k]))
+        mCheckers = getAttackersBB(k, mThem);
+    else
+        mCheckers = 0;
+
+    for (Color c : { white, black })
+    {
+        k = getKingSquare(c);
+        if ((moved == king && c == mThem)
+            || (vacated | occupied) & (bishopMoves[k] | rookMoves[k]))
+            setPins(c);
+    }
+
+    setCheckSquares();
+
+    if (NNUE::enabled)
+        refreshAccumulator();
+}
+
+// Recompute the network's accumulators marked dirty, or both when pAll is set.
+void State::refreshAccumulator(bool pAll)
+{
+    for (Color c : { white, black })
+        if (pAll || mAccumulator.dirty[c])
+            NNUE::refresh(mAccumulator, *this, c);
 }
 
 void State::makeNull()
@@ -706,6 +914,119 @@ void State::makeNull()
     mCheckSquares[queen] = mCheckSquares[bishop] | mCheckSquares[rook];
 }
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Make and unmake. make records what make_t is about to lose in pUndo, then  //
+// plays the move with make_t. unmake walks the pieces back, restores the     //
+// rest from pUndo and leaves the state as it was before make, piece lists    //
+// included.                                                                  //
+//                                                                            //
+// With NNUE on, the accumulators are updated backwards by the same piece     //
+// moves. A king move leaves its side dirty, so that side is refreshed at the //
+// end of unmake just as it was at the end of make_t.                         //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void State::make(Move pMove, Undo& pUndo)
+{
+    Square src = getSrc(pMove);
+    Square dst = getDst(pMove);
+    Square capture = dst;
+
+    pUndo.key = mKey;
+    pUndo.pawnKey = mPawnKey;
+    pUndo.materialKey = mMaterialKey;
+    pUndo.checkers = mCheckers;
+    pUndo.enPassant = mEnPassant;
+    pUndo.pinned = mPinned;
+    pUndo.checkSquares = mCheckSquares;
+    pUndo.castleRights = mCastleRights;
+    pUndo.fiftyMoveRule = mFiftyMoveRule;
+    pUndo.phase = mPhase;
+    pUndo.movedIndex = mPieceIndex[src];
+
+    if (isEnPassant(pMove))
+        capture = mUs == white ? dst - 8 : dst + 8;
+
+    pUndo.captured = isCastle(pMove) ? none : onSquare(capture);
+    pUndo.capturedIndex = pUndo.captured == none ? 0 : mPieceIndex[capture];
+
+    make_t(pMove);
+}
+
+void State::unmake(Move pMove, const Undo& pUndo)
+{
+    Square src = getSrc(pMove);
+    Square dst = getDst(pMove);
+    PieceType moved = onSquare(dst);
+
+    swapTurn();
+
+    if (isCastle(pMove))
+    {
+        // Kingside Castle
+        if (dst < src)
+        {
+            movePiece(mUs, king, dst, src);
+            movePiece(mUs, rook, dst+1, src-3);
+        }
+        // Queenside Castle
+        else
+        {
+            movePiece(mUs, king, dst, src);
+            movePiece(mUs, rook, dst-1, src+4);
+        }
+    }
+    else
+    {
+        if (getPiecePromo(pMove))
+        {
+            removePiece(mUs, moved, dst);
+            restorePiece(mUs, pawn, dst, pUndo.movedIndex);
+            moved = pawn;
+        }
+        movePiece(mUs, moved, dst, src);
+    }
+
+    if (pUndo.captured != none)
+    {
+        Square capture = dst;
+        if (moved == pawn && square_bb[dst] & pUndo.enPassant)
+            capture = mUs == white ? dst - 8 : dst + 8;
+        restorePiece(mThem, pUndo.captured, capture, pUndo.capturedIndex);
+    }
+
+    mKey = pUndo.key;
+    mPawnKey = pUndo.pawnKey;
+    mMaterialKey = pUndo.materialKey;
+    mCheckers = pUndo.checkers;
+    mEnPassant = pUndo.enPassant;
+    mPinned = pUndo.pinned;
+    mCheckSquares = pUndo.checkSquares;
+    mCastleRights = pUndo.castleRights;
+    mFiftyMoveRule = pUndo.fiftyMoveRule;
+    mPhase = pUndo.phase;
+
+    if (NNUE::enabled)
+        refreshAccumulator();
+}
+
+void State::makeNull(Undo& pUndo)
+{
+    pUndo.key = mKey;
+    pUndo.enPassant = mEnPassant;
+    pUndo.checkSquares = mCheckSquares;
+    makeNull();
+}
+
+void State::unmakeNull(const Undo& pUndo)
+{
+    mThem =  mUs;
+    mUs   = !mUs;
+    mKey = pUndo.key;
+    mEnPassant = pUndo.enPassant;
+    mCheckSquares = pUndo.checkSquares;
+}
+
 bool State::insufficientMaterial() const
 {
     bool ret = false;
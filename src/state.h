@@ -16,6 +16,7 @@
 #include "types.h"
 #include "move.h"
 #include "zobrist.h"
+#include "nnue.h"
 
 enum Phase
 {
@@ -27,7 +28,33 @@ enum Phase
     totalPhase  = 24
 };
 
-class State
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// What unmake needs to take a move back in place. The pieces are moved back  //
+// by hand; everything else make_t changes (keys, counters, the check and pin //
+// bitboards) is simply restored from here. The list indices put a captured   //
+// or promoted piece back in the same piece list slot, so move generation     //
+// after unmake runs in the same order as on a copy.                          //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct Undo
+{
+    U64 key;
+    U64 pawnKey;
+    U64 materialKey;
+    U64 checkers;
+    U64 enPassant;
+    std::array<U64, Player_size> pinned;
+    std::array<U64, Types_size> checkSquares;
+    int castleRights;
+    int fiftyMoveRule;
+    int phase;
+    PieceType captured;
+    int capturedIndex;
+    int movedIndex;
+};
+
+class alignas(64) State
 {
 public:
     State() {};
@@ -41,14 +68,17 @@ public:
     int getFiftyMoveRule() const;
     U64 getKey() const;
     U64 getPawnKey() const;
+    U64 getMaterialKey() const;
     U64 getEnPassantBB() const;
     int getCastleRights() const;
     U64 getCheckersBB() const;
     PieceType onSquare(const Square s) const;
     Square getKingSquare(Color c) const;
-    int getPstScore(GameStage g) const;
-    float getGamePhase() const;
+    Score getPstScore() const;
+    int getGamePhase() const;
     void setGamePhase();
+    const NNUE::Accumulator& getAccumulator() const;
+    void refreshAccumulator(bool pAll = false);
 
     // Access piece bitboards.
     template<PieceType P> const std::array<Square, Piece_max>& getPieceList(Color pColor) const;
@@ -77,17 +107,27 @@ public:
     // Functions involved in making a move.
     void make_t(Move m);
     void makeNull();
+    void make(Move pMove, Undo& pUndo);
+    void unmake(Move pMove, const Undo& pUndo);
+    void makeNull(Undo& pUndo);
+    void unmakeNull(const Undo& pUndo);
     void addPiece(Color pColor, PieceType pPiece, Square pSquare);
     void movePiece(Color pColor, PieceType pPiece, Square pSrc, Square pDst);
     void removePiece(Color pColor, PieceType pPiece, Square pSquare);
+    void restorePiece(Color pColor, PieceType pPiece, Square pSquare, int pIndex);
     void swapTurn();
+    void accumulate(Color pColor, PieceType pPiece, Square pRemoved, Square pAdded);
 
     // Valid king moves and pins.
     U64 getCheckSquaresBB(PieceType pPiece) const;
     void setCheckers();
+    void setCheckSquares();
     void setPins(Color c);
+    U64 findPins(Color c) const;
+    bool checkersAndPinsValid() const;
     U64 getPinsBB(Color c) const;
     U64 getDiscoveredChecks(Color c) const;
+    U64 getThreatsBB(Color c, U64 pOcc) const;
 
     // Check and attack information.
     bool isLegal(Move pMove) const;
@@ -105,30 +145,46 @@ public:
     template<PieceType> U64 getAttackBB(Square s, Color c=white) const;
     U64 getAttackBB(PieceType pPiece, Square pSquare, U64 pOcc) const;
     int see(Move m) const;
+    bool seeGe(Move m, int threshold) const;
     U64 getXRayAttacks(Square square) const;
 
     // Print
     friend std::ostream & operator << (std::ostream & o, const State & state);
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Members are ordered by how often move generation, legality checks and      //
+// make_t read them. The first cache line holds the side to move, en-passant, //
+// checkers, occupancy, pins and the key, the next two the piece bitboards    //
+// and the board. Squares, piece types and colors are one byte each, so the   //
+// board state fits in eight cache lines.                                     //
+//                                                                            //
+// The NNUE accumulators come last and are twice that again, which makes      //
+// sizeof(State) 1536. Copies skip them unless NNUE::enabled, but every State //
+// on the stack still has room for them. bench state reports both sizes.      //
+//                                                                            //
+// -------------------------------------------------------------------------- //
 private:
     Color mUs;
     Color mThem;
-    int mFiftyMoveRule;
-    int mCastleRights;
-    float mPhase;
-    U64 mKey;
-    U64 mPawnKey;
-    U64 mCheckers;
+    uint8_t mCastleRights;
+    int16_t mPhase;
+    uint16_t mFiftyMoveRule;
     U64 mEnPassant;
-    std::array<U64, Types_size> mCheckSquares;
-    std::array<U64, Player_size> mPinned;
+    U64 mCheckers;
     std::array<U64, Player_size> mOccupancy;
-    std::array<int, Board_size> mPieceIndex;
-    std::array<PieceType, Board_size> mBoard;
+    std::array<U64, Player_size> mPinned;
+    U64 mKey;
     std::array<std::array<U64, Types_size>, Player_size> mPieces;
-    std::array<std::array<int, Types_size>, Player_size> mPieceCount;
-    std::array<std::array<int, gameStageSize>, Player_size> mPstScore;
+    std::array<PieceType, Board_size> mBoard;
+    std::array<U64, Types_size> mCheckSquares;
+    U64 mPawnKey;
+    U64 mMaterialKey;
+    std::array<Score, Player_size> mPstScore;
+    std::array<std::array<uint8_t, Types_size>, Player_size> mPieceCount;
+    std::array<uint8_t, Board_size> mPieceIndex;
     std::array<std::array<std::array<Square, Piece_max>, Types_size>, Player_size> mPieceList;
+    NNUE::Accumulator mAccumulator;              // Only kept up when NNUE::enabled.
 };
 
 inline Color State::getOurColor() const
@@ -156,6 +212,11 @@ inline U64 State::getPawnKey() const
     return mPawnKey;
 }
 
+inline U64 State::getMaterialKey() const
+{
+    return mMaterialKey;
+}
+
 inline U64 State::getEnPassantBB() const
 {
     return mEnPassant;
@@ -171,14 +232,14 @@ inline U64 State::getPinsBB(Color c) const
     return mPinned[c];
 }
 
-inline float State::getGamePhase() const
+inline int State::getGamePhase() const
 {
     return mPhase;
 }
 
 inline void State::setGamePhase()
 {
-    float phase = totalPhase
+    int phase = totalPhase
                 - getPieceCount<pawn>()   * pawnPhase
                 - getPieceCount<knight>() * knightPhase
                 - getPieceCount<bishop>() * bishopPhase
@@ -188,6 +249,35 @@ inline void State::setGamePhase()
     mPhase = (phase * 256 + (totalPhase / 2)) / totalPhase;
 }
 
+inline const NNUE::Accumulator& State::getAccumulator() const
+{
+    return mAccumulator;
+}
+
+// Keep the network's accumulators in step with a piece being added, moved or
+// removed. A king move invalidates its own side, which is then refreshed at
+// the end of make_t.
+inline void State::accumulate(Color pColor, PieceType pPiece, Square pRemoved, Square pAdded)
+{
+    if (pPiece == king)
+    {
+        mAccumulator.dirty[pColor] = true;
+        return;
+    }
+
+    for (Color c : { white, black })
+    {
+        if (mAccumulator.dirty[c])
+            continue;
+        Square kingSq = getKingSquare(c);
+        NNUE::update(mAccumulator.values[c],
+                     pRemoved == no_sq ? NNUE::No_feature
+                                       : NNUE::featureIndex(c, kingSq, pColor, pPiece, pRemoved),
+                     pAdded == no_sq ? NNUE::No_feature
+                                     : NNUE::featureIndex(c, kingSq, pColor, pPiece, pAdded));
+    }
+}
+
 inline bool State::isCapture(Move pMove) const
 {
     return square_bb[getDst(pMove)] & (getOccupancyBB(mThem) | mEnPassant);
@@ -215,13 +305,16 @@ inline void State::addPiece(Color pColor, PieceType pPiece, Square pSquare)
     mPieces[pColor][pPiece] |= square_bb[pSquare];
     mOccupancy[pColor] |= square_bb[pSquare];
     mBoard[pSquare] = pPiece;
+    mMaterialKey ^= Zobrist::key(pColor, pPiece, Square(mPieceCount[pColor][pPiece]));
     mPieceIndex[pSquare] = mPieceCount[pColor][pPiece]++;
     mPieceList[pColor][pPiece][mPieceIndex[pSquare]] = pSquare;
 
-    mPstScore[pColor][middle] += PieceSquareTable::getScore(pPiece, middle, pColor, pSquare);
-    mPstScore[pColor][late] += PieceSquareTable::getScore(pPiece, late, pColor, pSquare);
+    mPstScore[pColor] += PieceSquareTable::getScore(pPiece, pColor, pSquare);
 
     mKey ^= Zobrist::key(pColor, pPiece, pSquare);
+
+    if (NNUE::enabled)
+        accumulate(pColor, pPiece, no_sq, pSquare);
 }
 
 inline void State::movePiece(Color pColor, PieceType pPiece, Square pSrc, Square pDst)
@@ -233,12 +326,13 @@ inline void State::movePiece(Color pColor, PieceType pPiece, Square pSrc, Square
     mPieceIndex[pDst] = mPieceIndex[pSrc];
     mPieceList[pColor][pPiece][mPieceIndex[pDst]] = pDst;
 
-    mPstScore[pColor][middle] -= PieceSquareTable::getScore(pPiece, middle, pColor, pSrc);
-    mPstScore[pColor][late] -= PieceSquareTable::getScore(pPiece, late, pColor, pSrc);
-    mPstScore[pColor][middle] += PieceSquareTable::getScore(pPiece, middle, pColor, pDst);
-    mPstScore[pColor][late] += PieceSquareTable::getScore(pPiece, late, pColor, pDst);
+    mPstScore[pColor] += PieceSquareTable::getScore(pPiece, pColor, pDst)
+                       - PieceSquareTable::getScore(pPiece, pColor, pSrc);
 
     mKey ^= Zobrist::key(pColor, pPiece, pSrc, pDst);
+
+    if (NNUE::enabled)
+        accumulate(pColor, pPiece, pSrc, pDst);
 }
 
 inline void State::removePiece(Color pColor, PieceType pPiece, Square pSquare)
@@ -251,16 +345,33 @@ inline void State::removePiece(Color pColor, PieceType pPiece, Square pSquare)
     mBoard[pSquare] = none;
 
     pieceCount = --mPieceCount[pColor][pPiece];
+    mMaterialKey ^= Zobrist::key(pColor, pPiece, Square(pieceCount));
 
     swap = mPieceList[pColor][pPiece][pieceCount];
     mPieceIndex[swap] = mPieceIndex[pSquare];
     mPieceList[pColor][pPiece][mPieceIndex[swap]] = swap;
     mPieceList[pColor][pPiece][pieceCount] = no_sq;
 
-    mPstScore[pColor][middle] -= PieceSquareTable::getScore(pPiece, middle, pColor, pSquare);
-    mPstScore[pColor][late] -= PieceSquareTable::getScore(pPiece, late, pColor, pSquare);
+    mPstScore[pColor] -= PieceSquareTable::getScore(pPiece, pColor, pSquare);
 
     mKey ^= Zobrist::key(pColor, pPiece, pSquare);
+
+    if (NNUE::enabled)
+        accumulate(pColor, pPiece, pSquare, no_sq);
+}
+
+// Add a piece back into slot pIndex of its piece list, the slot removePiece
+// took it from. The piece removePiece moved into that slot goes back to the
+// end of the list.
+inline void State::restorePiece(Color pColor, PieceType pPiece, Square pSquare, int pIndex)
+{
+    addPiece(pColor, pPiece, pSquare);
+
+    Square swap = mPieceList[pColor][pPiece][pIndex];
+    mPieceIndex[swap] = mPieceIndex[pSquare];
+    mPieceList[pColor][pPiece][mPieceIndex[swap]] = swap;
+    mPieceIndex[pSquare] = pIndex;
+    mPieceList[pColor][pPiece][pIndex] = pSquare;
 }
 
 inline
@@ -308,9 +419,9 @@ Square State::getKingSquare(Color c) const
 }
 
 inline
-int State::getPstScore(GameStage g) const
+Score State::getPstScore() const
 {
-    return mPstScore[mUs][g] - mPstScore[mThem][g];
+    return mPstScore[mUs] - mPstScore[mThem];
 }
 
 inline
@@ -382,19 +493,19 @@ inline U64 State::getAttackBB<knight>(Square s, Color c) const
 template<>
 inline U64 State::getAttackBB<bishop>(Square s, Color c) const
 {
-    return Bmagic(s, getOccupancyBB());
+    return bishop_attacks(s, getOccupancyBB());
 }
 
 template<>
 inline U64 State::getAttackBB<rook>(Square s, Color c) const
 {
-    return Rmagic(s, getOccupancyBB());
+    return rook_attacks(s, getOccupancyBB());
 }
 
 template<>
 inline U64 State::getAttackBB<queen>(Square s, Color c) const
 {
-    return Qmagic(s, getOccupancyBB());
+    return queen_attacks(s, getOccupancyBB());
 }
 
 template<>
@@ -408,10 +519,10 @@ U64 State::getAttackBB(PieceType pPiece, Square pSquare, U64 pOcc) const
 {
     assert(pPiece != pawn);
     assert(pPiece != king);
-    return pPiece == knight ? getAttackBB<knight>(pSquare) :
-           pPiece == bishop ? Bmagic(pSquare, pOcc)        :
-           pPiece == rook   ? Rmagic(pSquare, pOcc)        :
-                              Qmagic(pSquare, pOcc);
+    return pPiece == knight ? getAttackBB<knight>(pSquare)  :
+           pPiece == bishop ? bishop_attacks(pSquare, pOcc) :
+           pPiece == rook   ? rook_attacks(pSquare, pOcc)   :
+                              queen_attacks(pSquare, pOcc);
 }
 
 inline 
@@ -424,6 +535,12 @@ inline
 void State::setCheckers()
 {
     mCheckers = getAttackersBB(getKingSquare(mUs), mThem);
+    setCheckSquares();
+}
+
+inline
+void State::setCheckSquares()
+{
     mCheckSquares[pawn] = getAttackBB<pawn>(getKingSquare(mThem), mThem);
     mCheckSquares[knight] = getAttackBB<knight>(getKingSquare(mThem));
     mCheckSquares[bishop] = getAttackBB<bishop>(getKingSquare(mThem));
@@ -446,8 +563,8 @@ bool State::isAttacked(Square pSquare, Color pColor, U64 pChange) const
     U64 occupancy = getOccupancyBB() ^ pChange;
     return getAttackBB<pawn>(pSquare, pColor) & getPieceBB<pawn>(!pColor)
         || getAttackBB<knight>(pSquare) & getPieceBB<knight>(!pColor)
-        || Bmagic(pSquare, occupancy) & (getPieceBB<bishop>(!pColor) | getPieceBB<queen>(!pColor))
-        || Rmagic(pSquare, occupancy) & (getPieceBB<rook>(!pColor) | getPieceBB<queen>(!pColor))
+        || bishop_attacks(pSquare, occupancy) & (getPieceBB<bishop>(!pColor) | getPieceBB<queen>(!pColor))
+        || rook_attacks(pSquare, occupancy) & (getPieceBB<rook>(!pColor) | getPieceBB<queen>(!pColor))
         || getAttackBB<king>(pSquare) & getPieceBB<king>(!pColor);
 }
 
@@ -501,15 +618,15 @@ U64 State::allAttackers(Square s) const
 inline
 bool State::check(U64 change) const
 {
-    return (Bmagic(getKingSquare(mUs), getOccupancyBB() ^ change) & (getPieceBB<bishop>(mThem) | getPieceBB<queen>(mThem)))
-        || (Rmagic(getKingSquare(mUs), getOccupancyBB() ^ change) & (getPieceBB< rook >(mThem) | getPieceBB<queen>(mThem)));
+    return (bishop_attacks(getKingSquare(mUs), getOccupancyBB() ^ change) & (getPieceBB<bishop>(mThem) | getPieceBB<queen>(mThem)))
+        || (rook_attacks(getKingSquare(mUs), getOccupancyBB() ^ change) & (getPieceBB< rook >(mThem) | getPieceBB<queen>(mThem)));
 }
 
 inline
 bool State::check(U64 change, Color c) const
 {
-    return (Bmagic(getKingSquare(c), getOccupancyBB() ^ change) & (getPieceBB<bishop>(!c) | getPieceBB<queen>(!c)))
-        || (Rmagic(getKingSquare(c), getOccupancyBB() ^ change) & (getPieceBB< rook >(!c) | getPieceBB<queen>(!c)));
+    return (bishop_attacks(getKingSquare(c), getOccupancyBB() ^ change) & (getPieceBB<bishop>(!c) | getPieceBB<queen>(!c)))
+        || (rook_attacks(getKingSquare(c), getOccupancyBB() ^ change) & (getPieceBB< rook >(!c) | getPieceBB<queen>(!c)));
 }
 
 inline
@@ -1,3 +1,7 @@
+#include <iomanip>
+#include <atomic>
+#include <thread>
+#include <limits>
 #include "test.h"
 
 const int ccrTotalTests = 25;
@@ -62,30 +66,700 @@ const std::string ccrResults[ccrTotalTests]
 
 void ccrTest()
 {
+	SearchThread thread(0, ttable);
+
 	for (int i = 0; i < ccrTotalTests; ++i)
 	{
 		State s(ccrFen[i]);
-		history.clear();
-		history.push(std::make_pair(nullMove, s.getKey()));
+		thread.history.init();
+		thread.history.push(std::make_pair(nullMove, s.getKey()));
 		SearchInfo si;
 		si.moveTime = allocate_time(10000000, 0, 40);
 		si.clock.set();
 		// Clear the game list.
 		ttable.clear();
-		lineManager.clearPv();
+		thread.clear();
 
 		int score;
 		for (int d = 1; d < 9; ++d)
 		{
-			score = scout_search(s, si, d, 0, Neg_inf, Pos_inf, true, false, true);
+			score = scout_search(thread, s, si, d, 0, Neg_inf, Pos_inf, true, false, true);
 			if (si.quit)
 				break;
 		}
 
-		Move pv = lineManager.getPvMove();
+		Move pv = thread.lineManager.getPvMove();
 
 		std::cout << s;
-		std::cout << "bestmove " << getSrc(pv) << toString(pv) << std::endl;
+		std::cout << "bestmove " << int(getSrc(pv)) << toString(pv) << std::endl;
 		std::cout << ccrResults[i] << '\n';
 	}
-}
\ No newline at end of file
+}
+
+// Searches ccr position i to depth, silently, with a cleared hash and the
+// current threadCount, and returns the node count. In a COUNT_ALLOCATIONS
+// build the allocations made by the search itself are added to allocs.
+static uint64_t searchCcr(int i, int depth, uint64_t* allocs = nullptr)
+{
+	State s(ccrFen[i]);
+	History game;
+	game.push(std::make_pair(nullMove, s.getKey()));
+	ttable.clear();
+	clear_caches();
+
+	SearchInfo si;
+	si.depth = depth + 1;
+	si.moveTime = std::numeric_limits<int64_t>::max() / 2;
+	si.silent = true;
+	si.clock.set();
+#if defined(COUNT_ALLOCATIONS)
+	const uint64_t before = allocationCount();
+	setup_search(s, si, game);
+	if (allocs)
+		*allocs += allocationCount() - before;
+#else
+	(void)allocs;
+	setup_search(s, si, game);
+#endif
+	return total_nodes();
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Time to depth benchmark. Search each of the ccr positions to a fixed depth //
+// with 1, 2, 4, ... threads and report the total time and the speedup over   //
+// a single thread. The hash is cleared before every position so each run     //
+// starts from the same state.                                                //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void ttdBench(int depth)
+{
+	const int savedThreads = threadCount;
+	const int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	double baseTime = 0.0;
+
+	std::cout << ' ' << std::setfill('-') << std::setw(53) << std::right << ' '
+	          << std::endl;
+	std::cout << "| threads | time (s)   | nodes         | speedup       |"
+	          << std::endl;
+	std::cout << "|" << std::setfill('-') << std::setw(53) << std::right << "|"
+	          << std::endl;
+
+	for (int threads = 1; threads <= std::min(maxThreads, Max_threads); threads *= 2)
+	{
+		uint64_t nodes = 0;
+		Clock clock;
+
+		threadCount = threads;
+		clock.set();
+
+		for (int i = 0; i < ccrTotalTests; ++i)
+			nodes += searchCcr(i, depth);
+
+		double time = clock.elapsed<std::chrono::microseconds>() / 1000000.0;
+		if (threads == 1)
+			baseTime = time;
+
+		std::cout << "| " << std::setfill(' ') << std::setw(8) << std::left << threads
+		          << "| " << std::setw(11) << std::fixed << std::setprecision(3) << time
+		          << "| " << std::setw(14) << nodes
+		          << "| " << std::setw(14) << std::setprecision(2)
+		          << (time > 0.0 ? baseTime / time : 0.0) << "|" << std::endl;
+	}
+
+	std::cout << ' ' << std::setfill('-') << std::setw(53) << std::right << ' '
+	          << std::endl;
+
+	threadCount = savedThreads;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Transposition table stress test. Several threads store and probe a small   //
+// pool of keys that all land in the same few clusters, so slots are being    //
+// overwritten by other keys all the time. Every stored field is derived from //
+// the key, so any hit whose fields don't match the probed key is an entry    //
+// that a torn write let through.                                             //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+static U64 stressKey(TranspositionTable& table, uint32_t i)
+{
+	const U64 clusters = table.size() / Cluster_size;
+	const U64 high = static_cast<U64>(i * 0x9E3779B1u) << 32;
+	const U64 target = i % 8;
+	return high | (((target << 32) + clusters - 1) / clusters);
+}
+
+static Move stressMove(U64 key)  { return static_cast<Move>((key >> 32) | 1); }
+static int  stressScore(U64 key) { return static_cast<int>((key >> 40) % 30000); }
+static int  stressEval(U64 key)  { return -static_cast<int>((key >> 48) % 30000); }
+
+void ttStressTest(int threads)
+{
+	const int keyCount = 256;
+	const int iterations = 1000000;
+	TranspositionTable table;
+	std::atomic<uint64_t> probes(0), hits(0), corrupt(0);
+	std::vector<std::thread> workers;
+	Clock clock;
+
+	clock.set();
+	for (int id = 0; id < threads; ++id)
+	{
+		workers.emplace_back([&, id]()
+		{
+			U64 rng = 0x9E3779B97F4A7C15ull * (id + 1);
+			uint64_t localHits = 0, localCorrupt = 0;
+
+			for (int n = 0; n < iterations; ++n)
+			{
+				rng ^= rng << 13;
+				rng ^= rng >> 7;
+				rng ^= rng << 17;
+
+				U64 key = stressKey(table, rng % keyCount);
+				if (rng & 0x100000)
+				{
+					table.store(key, stressMove(key), static_cast<NodeType>((rng >> 8) % 3),
+					            (rng >> 12) % 64, stressScore(key), stressEval(key));
+					continue;
+				}
+
+				TableEntry entry;
+				if (table.probe(key, entry))
+				{
+					++localHits;
+					if (entry.best != stressMove(key)
+					 || entry.score != stressScore(key)
+					 || entry.eval != stressEval(key))
+						++localCorrupt;
+				}
+			}
+
+			probes += iterations;
+			hits += localHits;
+			corrupt += localCorrupt;
+		});
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	std::cout << "threads " << threads
+	          << " ops " << probes
+	          << " hits " << hits
+	          << " corrupt " << corrupt
+	          << " time " << clock.elapsed<std::chrono::milliseconds>() << "ms"
+	          << (corrupt ? " FAILED" : " passed") << std::endl;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Network evaluation benchmark. Plays a few moves into each ccr position,    //
+// checking after every move that the incrementally updated accumulators      //
+// match ones computed from scratch, then times the network against the       //
+// classical evaluation over the positions reached.                           //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void nnueBench()
+{
+	const int plies = 16;
+	const int rounds = 2000;
+	const bool savedEnabled = NNUE::enabled;
+	std::vector<State> positions;
+	int mismatches = 0;
+
+	if (!NNUE::loaded())
+	{
+		std::cout << "info string no network loaded, set UseNNUE first" << std::endl;
+		return;
+	}
+
+	NNUE::enabled = true;
+	for (int i = 0; i < ccrTotalTests; ++i)
+	{
+		State s(ccrFen[i]);
+		for (int ply = 0; ply < plies; ++ply)
+		{
+			MoveList mlist(s);
+			if (mlist.size() == 0)
+				break;
+			for (int n = (ply * 7 + i) % mlist.size(); n > 0; --n)
+				mlist.pop();
+			s.make_t(mlist.pop());
+
+			State fresh(s);
+			fresh.refreshAccumulator(true);
+			if (std::memcmp(fresh.getAccumulator().values, s.getAccumulator().values,
+			                sizeof(s.getAccumulator().values)))
+				++mismatches;
+			positions.push_back(s);
+		}
+	}
+
+	PawnHash pawnHash;
+	MaterialHash materialHash;
+	volatile int sink = 0;
+	Clock clock;
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (const State& s : positions)
+			sink = sink + NNUE::evaluate(s);
+	double nnueTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (const State& s : positions)
+		{
+			Evaluate evaluate(s, pawnHash, *materialHash.probe(s));
+			sink = sink + evaluate.getScore();
+		}
+	double classicalTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	const double evals = static_cast<double>(rounds) * positions.size();
+	std::cout << "positions   " << positions.size() << '\n'
+	          << "mismatches  " << mismatches << '\n'
+	          << "simd        " << NNUE::simd() << '\n'
+	          << std::fixed << std::setprecision(1)
+	          << "nnue        " << nnueTime / evals << " ns/eval\n"
+	          << "classical   " << classicalTime / evals << " ns/eval" << std::endl;
+
+	NNUE::enabled = savedEnabled;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// make_t and Evaluate throughput. Every legal move of every ccr position is  //
+// made on a copy of the position, then every position reached is evaluated.  //
+// The pawn and material tables are warm, so this measures the code itself.   //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void evalBench()
+{
+	const int rounds = 200;
+	std::vector<State> roots, children;
+	std::vector<std::vector<Move>> moves;
+
+	for (int i = 0; i < ccrTotalTests; ++i)
+	{
+		roots.push_back(State(ccrFen[i]));
+		moves.push_back(std::vector<Move>());
+		MoveList mlist(roots.back());
+		while (mlist.size() > 0)
+		{
+			moves.back().push_back(mlist.pop());
+			State c(roots.back());
+			c.make_t(moves.back().back());
+			children.push_back(c);
+		}
+	}
+
+	PawnHash pawnHash;
+	MaterialHash materialHash;
+	volatile U64 sink = 0;
+	Clock clock;
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (int i = 0; i < ccrTotalTests; ++i)
+			for (Move m : moves[i])
+			{
+				State c(roots[i]);
+				c.make_t(m);
+				sink = sink ^ c.getKey();
+			}
+	double makeTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (const State& s : children)
+		{
+			Evaluate evaluate(s, pawnHash, *materialHash.probe(s));
+			sink = sink + evaluate.getScore();
+		}
+	double evalTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	const double count = static_cast<double>(rounds) * children.size();
+	std::cout << "positions   " << children.size() << '\n'
+	          << std::fixed << std::setprecision(1)
+	          << "make_t      " << makeTime / count << " ns/move\n"
+	          << "evaluate    " << evalTime / count << " ns/eval" << std::endl;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Slider attack benchmark. Times bishop and rook lookups from every square   //
+// against the occupancy of each ccr position, then perft from the same       //
+// positions, once with the magic tables and once with PEXT if the cpu has    //
+// it. Both backends must agree on every lookup and on the node counts.       //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void sliderBench(int depth)
+{
+	const int rounds = 2000;
+	const bool savedEnabled = Pext::enabled;
+	std::vector<U64> occupancies, expected;
+
+	for (int i = 0; i < ccrTotalTests; ++i)
+		occupancies.push_back(State(ccrFen[i]).getOccupancyBB());
+
+	std::cout << ' ' << std::setfill('-') << std::setw(62) << std::right << ' '
+	          << std::endl;
+	std::cout << "| backend | lookup (ns) | perft (s)  | nodes         | errors  |"
+	          << std::endl;
+	std::cout << "|" << std::setfill('-') << std::setw(62) << std::right << "|"
+	          << std::endl;
+
+	for (int backend = 0; backend < 2; ++backend)
+	{
+		const bool pext = backend == 1;
+		if (pext && !Pext::available())
+		{
+			std::cout << "| pext    | " << std::setfill(' ') << std::setw(50) << std::left
+			          << "not available on this cpu" << "|" << std::endl;
+			break;
+		}
+		Pext::enabled = pext;
+
+		uint64_t errors = 0;
+		size_t n = 0;
+		for (U64 occ : occupancies)
+			for (Square s = first_sq; s <= last_sq; ++s)
+			{
+				U64 attacks = bishop_attacks(s, occ) ^ (rook_attacks(s, occ) << 1);
+				if (!pext)
+					expected.push_back(attacks);
+				else if (attacks != expected[n])
+					++errors;
+				++n;
+			}
+
+		U64 sum = 0;
+		Clock clock;
+		clock.set();
+		for (int r = 0; r < rounds; ++r)
+			for (U64 occ : occupancies)
+				for (Square s = first_sq; s <= last_sq; ++s)
+					sum += bishop_attacks(s, occ) ^ rook_attacks(s, occ);
+		double lookupTime = clock.elapsed<std::chrono::nanoseconds>()
+		                  / (2.0 * rounds * occupancies.size() * Board_size);
+		if (sum == 0)
+			std::cout << std::endl;
+
+		uint64_t nodes = 0;
+		clock.set();
+		for (int i = 0; i < ccrTotalTests; ++i)
+		{
+			State s(ccrFen[i]);
+			nodes += perft(s, depth);
+		}
+		double perftTime = clock.elapsed<std::chrono::microseconds>() / 1000000.0;
+
+		std::cout << "| " << std::setfill(' ') << std::setw(8) << std::left << Pext::backend()
+		          << "| " << std::setw(12) << std::fixed << std::setprecision(2) << lookupTime
+		          << "| " << std::setw(11) << std::setprecision(3) << perftTime
+		          << "| " << std::setw(14) << nodes
+		          << "| " << std::setw(8) << errors << "|" << std::endl;
+	}
+
+	std::cout << ' ' << std::setfill('-') << std::setw(62) << std::right << ' '
+	          << std::endl;
+
+	Pext::enabled = savedEnabled;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Slider lookup latency, with and without cache pressure. Each lookup's      //
+// square and occupancy depend on the result of the one before, so the time   //
+// per step is the latency of a lookup and not its throughput. For the cold   //
+// column every step also probes a random cluster of a large hash table, as   //
+// the search does, which keeps evicting attack table lines. A chain of       //
+// probes alone is timed first and subtracted.                                //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void sliderLatencyBench(int sizeMb)
+{
+	const int steps = 4000000;
+	const bool savedEnabled = Pext::enabled;
+	TranspositionTable table;
+	std::vector<U64> occupancies;
+	TableEntry entry;
+	Clock clock;
+
+	if (!table.resize(sizeMb))
+		return;
+	table.clear();
+	for (int i = 0; i < ccrTotalTests; ++i)
+		occupancies.push_back(State(ccrFen[i]).getOccupancyBB());
+
+	U64 rng = 0x9E3779B97F4A7C15ull;
+	clock.set();
+	for (int n = 0; n < steps; ++n)
+	{
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		rng += table.probe(rng, entry);
+	}
+	const double probeTime = clock.elapsed<std::chrono::nanoseconds>();
+	volatile U64 sink = rng;
+
+	std::cout << "hash " << sizeMb << " MiB, probe " << std::fixed << std::setprecision(2)
+	          << probeTime / steps << " ns" << '\n';
+	std::cout << ' ' << std::setfill('-') << std::setw(38) << std::right << ' '
+	          << std::endl;
+	std::cout << "| backend | warm (ns)   | cold (ns)   |" << std::endl;
+	std::cout << "|" << std::setfill('-') << std::setw(38) << std::right << "|"
+	          << std::endl;
+
+	for (int backend = 0; backend < 2; ++backend)
+	{
+		if (backend == 1 && !Pext::available())
+			break;
+		Pext::enabled = backend == 1;
+
+		U64 attacks = 0;
+		clock.set();
+		for (int n = 0; n < steps; ++n)
+		{
+			Square s = Square(attacks % Board_size);
+			U64 occ = occupancies[n % occupancies.size()] ^ (attacks & 1);
+			attacks += n & 1 ? rook_attacks(s, occ) : bishop_attacks(s, occ);
+		}
+		const double warmTime = clock.elapsed<std::chrono::nanoseconds>();
+
+		rng = 0x9E3779B97F4A7C15ull;
+		clock.set();
+		for (int n = 0; n < steps; ++n)
+		{
+			rng ^= rng << 13;
+			rng ^= rng >> 7;
+			rng ^= rng << 17;
+			rng += table.probe(rng, entry);
+
+			Square s = Square((attacks ^ rng) % Board_size);
+			U64 occ = occupancies[n % occupancies.size()] ^ (attacks & 1);
+			attacks = n & 1 ? rook_attacks(s, occ) : bishop_attacks(s, occ);
+			rng ^= attacks & 1;
+		}
+		const double coldTime = clock.elapsed<std::chrono::nanoseconds>() - probeTime;
+		sink = sink + attacks;
+
+		std::cout << "| " << std::setfill(' ') << std::setw(8) << std::left << Pext::backend()
+		          << "| " << std::setw(12) << std::setprecision(2) << warmTime / steps
+		          << "| " << std::setw(12) << coldTime / steps << "|" << std::endl;
+	}
+
+	std::cout << ' ' << std::setfill('-') << std::setw(38) << std::right << ' '
+	          << std::endl;
+
+	Pext::enabled = savedEnabled;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Allocation benchmark. Searches each ccr position to a fixed depth on one   //
+// thread and counts the heap allocations made by the search alone, which     //
+// should be zero: move lists, states and search stacks all live on the       //
+// stack or in tables set up before the search starts. Only counts in a       //
+// build with COUNT_ALLOCATIONS defined.                                      //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void allocBench(int depth)
+{
+#if !defined(COUNT_ALLOCATIONS)
+	(void)depth;
+	std::cout << "allocations are only counted in a build with COUNT_ALLOCATIONS "
+	          << "defined (make allocs)" << std::endl;
+#else
+	const int savedThreads = threadCount;
+	uint64_t nodes = 0, count = 0;
+
+	threadCount = 1;
+
+	// The first search creates the thread and sizes its tables, so run one
+	// untimed search before counting.
+	searchCcr(0, depth);
+	for (int i = 0; i < ccrTotalTests; ++i)
+		nodes += searchCcr(i, depth, &count);
+	threadCount = savedThreads;
+
+	std::cout << "nodes " << nodes
+	          << " allocations " << count
+	          << " per million nodes " << std::fixed << std::setprecision(2)
+	          << (nodes ? count * 1000000.0 / nodes : 0.0) << std::endl;
+#endif
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Make scheme benchmark. Runs perft 4 and a single thread search to depth on //
+// every ccr position and reports the speed of both. The scheme is chosen at  //
+// compile time, so compare a normal build against one made with MAKE_UNMAKE  //
+// defined (make unmake). Node counts must match between the two builds.      //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void makeBench(int depth)
+{
+#if defined(MAKE_UNMAKE)
+	const char* scheme = "make/unmake";
+#else
+	const char* scheme = "copy-make";
+#endif
+	const int perftDepth = 4;
+	const int savedThreads = threadCount;
+	uint64_t perftNodes = 0, searchNodes = 0;
+	double perftTime, searchTime;
+	Clock clock;
+
+	clock.set();
+	for (int i = 0; i < ccrTotalTests; ++i)
+	{
+		State s(ccrFen[i]);
+		perftNodes += perft(s, perftDepth);
+	}
+	perftTime = clock.elapsed<std::chrono::microseconds>() / 1000000.0;
+
+	threadCount = 1;
+	clock.set();
+	for (int i = 0; i < ccrTotalTests; ++i)
+		searchNodes += searchCcr(i, depth);
+	searchTime = clock.elapsed<std::chrono::microseconds>() / 1000000.0;
+	threadCount = savedThreads;
+
+	std::cout << scheme << std::fixed << std::setprecision(3)
+	          << "\nperft  " << perftNodes << " nodes " << perftTime << " s "
+	          << std::setprecision(0) << perftNodes / perftTime << " nps"
+	          << std::setprecision(3)
+	          << "\nsearch " << searchNodes << " nodes " << searchTime << " s "
+	          << std::setprecision(0) << searchNodes / searchTime << " nps" << std::endl;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// State size benchmark. Reports the size of State and times copying the ccr  //
+// positions into a small ring of states, as copy-make does for every node.   //
+// The accumulators are only copied with NNUE on, so that is timed as well    //
+// when a network is loaded.                                                  //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void stateBench()
+{
+	const int rounds = 1000000;
+	const int ringSize = 16;
+	const bool savedEnabled = NNUE::enabled;
+	std::vector<State> roots, ring(ringSize);
+	U64 sink = 0;
+
+	for (int i = 0; i < ccrTotalTests; ++i)
+		roots.emplace_back(ccrFen[i]);
+
+	std::cout << "sizeof(State) " << sizeof(State)
+	          << " alignof(State) " << alignof(State)
+	          << "\naccumulators  " << sizeof(NNUE::Accumulator)
+	          << " rest " << sizeof(State) - sizeof(NNUE::Accumulator)
+	          << " with padding" << std::endl;
+
+	for (int nnue = 0; nnue < (NNUE::loaded() ? 2 : 1); ++nnue)
+	{
+		NNUE::enabled = nnue;
+		Clock clock;
+
+		clock.set();
+		for (int n = 0; n < rounds; ++n)
+			ring[n % ringSize] = roots[n % roots.size()];
+		const double time = clock.elapsed<std::chrono::nanoseconds>();
+
+		for (const State& s : ring)
+			sink ^= s.getKey();
+
+		std::cout << "copy " << (nnue ? "with" : "without") << " accumulators "
+		          << std::fixed << std::setprecision(1) << time / rounds << " ns"
+		          << std::endl;
+	}
+
+	NNUE::enabled = savedEnabled;
+	if (sink == 0)
+		std::cout << std::endl;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// SEE benchmark. Collects every capture and promotion in the ccr positions   //
+// and the positions one move after them. seeGe must agree with see() on all  //
+// of them at each threshold. Then times see(m) >= 0 against seeGe(m, 0),     //
+// the test move ordering makes for every capture.                            //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void seeBench()
+{
+	const int rounds = 200;
+	const int thresholds[] = { -Queen_wt, -Rook_wt, -2 * Pawn_wt, -Pawn_wt, 0, 1,
+	                           Pawn_wt, 2 * Pawn_wt, Rook_wt, Queen_wt };
+	std::vector<std::pair<State, Move>> corpus;
+	std::vector<State> positions;
+	uint64_t checked = 0, errors = 0;
+	volatile int sink = 0;
+	Clock clock;
+
+	for (int i = 0; i < ccrTotalTests; ++i)
+	{
+		State s(ccrFen[i]);
+		positions.push_back(s);
+		MoveList mlist(s);
+		while (mlist.size() > 0)
+		{
+			State c(s);
+			c.make_t(mlist.pop());
+			positions.push_back(c);
+		}
+	}
+
+	for (const State& s : positions)
+	{
+		MoveList mlist(s);
+		while (mlist.size() > 0)
+		{
+			Move m = mlist.pop();
+			if (s.isCapture(m) || isPromotion(m))
+				corpus.push_back(std::make_pair(s, m));
+		}
+	}
+
+	for (const auto& entry : corpus)
+	{
+		const int see = entry.first.see(entry.second);
+		for (int threshold : thresholds)
+		{
+			++checked;
+			if (entry.first.seeGe(entry.second, threshold) != (see >= threshold))
+			{
+				if (errors++ < 10)
+					std::cout << "mismatch " << toString(entry.second)
+					          << " see " << see << " threshold " << threshold
+					          << '\n' << entry.first;
+			}
+		}
+	}
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (const auto& entry : corpus)
+			sink = sink + (entry.first.see(entry.second) >= 0);
+	const double seeTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	clock.set();
+	for (int r = 0; r < rounds; ++r)
+		for (const auto& entry : corpus)
+			sink = sink + entry.first.seeGe(entry.second, 0);
+	const double seeGeTime = clock.elapsed<std::chrono::nanoseconds>();
+
+	const double count = static_cast<double>(rounds) * corpus.size();
+	std::cout << "captures    " << corpus.size() << '\n'
+	          << "checked     " << checked << " errors " << errors << '\n'
+	          << std::fixed << std::setprecision(1)
+	          << "see         " << seeTime / count << " ns/move\n"
+	          << "seeGe       " << seeGeTime / count << " ns/move" << std::endl;
+}
@@ -7,7 +7,23 @@
 #include "time.h"
 #include "types.h"
 #include "move.h"
+#include "nnue.h"
+#include "perft.h"
 
 void ccrTest();
+void ttdBench(int depth);
+void ttStressTest(int threads);
+void nnueBench();
+void evalBench();
+void sliderBench(int depth);
+void sliderLatencyBench(int sizeMb);
+void allocBench(int depth);
+void makeBench(int depth);
+void stateBench();
+void seeBench();
+
+#if defined(COUNT_ALLOCATIONS)
+uint64_t allocationCount();                      // Calls to operator new so far.
+#endif
 
 #endif
\ No newline at end of file
@@ -1,3 +1,326 @@
 #include "transpositiontable.h"
+#include "zobrist.h"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
 
-TranspositionTable ttable;
\ No newline at end of file
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+TranspositionTable ttable;
+
+enum PageType
+{
+    smallPages,
+    transparentPages,
+    hugePages
+};
+
+static const std::size_t Huge_page_size = 2 * 1024 * 1024;
+static const int Keep_old_max = 256;             // MiB, see resize.
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Get zeroed memory for the table. On linux the table is mapped directly,    //
+// first asking for explicit huge pages and falling back to normal pages with //
+// a transparent huge page hint. Both hand back page aligned memory. On other //
+// platforms calloc is used and the table is aligned by hand.                 //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+static void* allocate(std::size_t& bytes, int& pages)
+{
+#if defined(__linux__)
+    bytes = (bytes + Huge_page_size - 1) / Huge_page_size * Huge_page_size;
+
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+    {
+        pages = hugePages;
+        return memory;
+    }
+
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return nullptr;
+
+    pages = smallPages;
+#if defined(MADV_HUGEPAGE)
+    if (!madvise(memory, bytes, MADV_HUGEPAGE))
+        pages = transparentPages;
+#endif
+    return memory;
+#else
+    bytes += 63;
+    pages = smallPages;
+    return std::calloc(bytes, 1);
+#endif
+}
+
+static void deallocate(void* memory, std::size_t bytes)
+{
+    if (!memory)
+        return;
+#if defined(__linux__)
+    munmap(memory, bytes);
+#else
+    std::free(memory);
+#endif
+}
+
+TranspositionTable::TranspositionTable()
+: mMemory(nullptr), mBytes(0), mPages(smallPages), mTable(nullptr), mClusters(0)
+, mSize(0), mGeneration(0)
+{
+    resize(Default_size);
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    deallocate(mMemory, mBytes);
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Zero the table, split into one contiguous block per thread. Besides being  //
+// faster on big tables, this is the first touch of freshly mapped memory, so //
+// the page faults are taken here rather than during the search.              //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+void TranspositionTable::clear(int threads)
+{
+    threads = std::max(1, threads);
+    const std::size_t chunk = (mClusters + threads - 1) / threads;
+    std::vector<std::thread> workers;
+
+    for (int i = 1; i < threads; ++i)
+    {
+        std::size_t begin = std::min(mClusters, i * chunk);
+        std::size_t end = std::min(mClusters, begin + chunk);
+        workers.emplace_back([this, begin, end]()
+        {
+            std::memset(static_cast<void*>(mTable + begin), 0, (end - begin) * sizeof(Cluster));
+        });
+    }
+
+    std::memset(static_cast<void*>(mTable), 0, std::min(mClusters, chunk) * sizeof(Cluster));
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Resize the table to size_mb MiB. The new memory is already zeroed, so no   //
+// clear is needed, though callers may still clear to touch the pages up      //
+// front. The table starts on the first cache line boundary of the block.     //
+//                                                                            //
+// A table over Keep_old_max is freed before the new one is mapped, so the    //
+// two never have to fit in memory at once. If the new one then can't be      //
+// had, fall back to the default size rather than run without a table. A      //
+// smaller table is kept until the new one exists, and survives a failure.    //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+bool TranspositionTable::resize(int size_mb)
+{
+    std::size_t clusters = (static_cast<std::size_t>(size_mb) << 20) / sizeof(Cluster);
+    std::size_t bytes = clusters * sizeof(Cluster);
+    int pages;
+
+    if (mSize > Keep_old_max)
+    {
+        deallocate(mMemory, mBytes);
+        mMemory = nullptr;
+        mBytes = 0;
+        mTable = nullptr;
+        mClusters = 0;
+        mSize = 0;
+    }
+
+    void* memory = allocate(bytes, pages);
+    if (!memory)
+    {
+        std::cout << "info string failed to allocate " << size_mb
+                  << " MiB for the hash table" << std::endl;
+        if (!mMemory && size_mb != Default_size)
+            resize(Default_size);
+        return false;
+    }
+
+    deallocate(mMemory, mBytes);
+    mMemory = memory;
+    mBytes = bytes;
+    mPages = pages;
+    mTable = reinterpret_cast<Cluster*>(
+        (reinterpret_cast<uintptr_t>(memory) + 63) & ~static_cast<uintptr_t>(63));
+    mClusters = clusters;
+    mSize = size_mb;
+    return true;
+}
+
+const char* TranspositionTable::pageType() const
+{
+    return mPages == hugePages       ? "huge pages"
+         : mPages == transparentPages ? "transparent huge pages"
+         : "small pages";
+}
+
+// Permill of the first thousand entries written during the current search,
+// as reported by the uci hashfull field.
+int TranspositionTable::hashfull() const
+{
+    const std::size_t clusters = std::min<std::size_t>(mClusters, 1000 / Cluster_size);
+    int count = 0;
+
+    for (std::size_t i = 0; i < clusters; ++i)
+    {
+        for (int j = 0; j < Cluster_size; ++j)
+        {
+            U64 data = mTable[i].data[j].load(std::memory_order_relaxed);
+            if (data && unpack(data).generation == mGeneration)
+                ++count;
+        }
+    }
+    return count * 1000 / static_cast<int>(clusters * Cluster_size);
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Hash files. A page sized header followed by the raw clusters, so the table //
+// starts page aligned in the file. The header records the Zobrist seed and a //
+// fingerprint of the keys, a table written by a build with different keys    //
+// would only produce garbage hits. Bump the version whenever the cluster     //
+// layout changes.                                                            //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+static const char Hash_file_magic[8] = { 'C', 'G', 'H', 'A', 'S', 'H', 0, 0 };
+static const uint32_t Hash_file_version = 1;
+static const std::size_t Header_bytes = 4096;
+
+struct HashFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;
+    U64 fingerprint;
+    U64 clusters;
+    uint32_t size;                               // In MiB.
+    uint32_t generation;
+};
+
+static bool validHeader(const HashFileHeader& header, std::size_t fileBytes)
+{
+    const char* error = nullptr;
+
+    if (std::memcmp(header.magic, Hash_file_magic, sizeof(Hash_file_magic)))
+        error = "not a hash file";
+    else if (header.version != Hash_file_version)
+        error = "unsupported hash file version";
+    else if (header.seed != Zobrist::Seed || header.fingerprint != Zobrist::fingerprint())
+        error = "hash file was written with different zobrist keys";
+    else if (header.size < 1 || header.size > Max_size
+          || header.clusters != (static_cast<std::size_t>(header.size) << 20) / sizeof(Cluster)
+          || fileBytes != Header_bytes + header.clusters * sizeof(Cluster))
+        error = "hash file is truncated or corrupt";
+
+    if (error)
+        std::cout << "info string " << error << std::endl;
+    return !error;
+}
+
+bool TranspositionTable::save(const std::string& path) const
+{
+    HashFileHeader header = {};
+    std::memcpy(header.magic, Hash_file_magic, sizeof(Hash_file_magic));
+    header.version = Hash_file_version;
+    header.seed = Zobrist::Seed;
+    header.fingerprint = Zobrist::fingerprint();
+    header.clusters = mClusters;
+    header.size = mSize;
+    header.generation = mGeneration;
+
+    std::vector<char> page(Header_bytes, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(page.data(), page.size());
+    file.write(reinterpret_cast<const char*>(mTable), mClusters * sizeof(Cluster));
+
+    if (!file)
+        std::cout << "info string failed to write hash file " << path << std::endl;
+    return static_cast<bool>(file);
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Load a hash file written by save. The table is resized to the size in the  //
+// file. Where mmap is available the file is mapped and copied straight into  //
+// the table, so loading costs about one sequential read of the file.         //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+bool TranspositionTable::load(const std::string& path)
+{
+    HashFileHeader header;
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) || static_cast<std::size_t>(st.st_size) < Header_bytes)
+    {
+        std::cout << "info string failed to open hash file " << path << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    const std::size_t bytes = st.st_size;
+    void* file = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+    {
+        std::cout << "info string failed to map hash file " << path << std::endl;
+        return false;
+    }
+
+#if defined(MADV_SEQUENTIAL)
+    madvise(file, bytes, MADV_SEQUENTIAL);
+#endif
+
+    std::memcpy(&header, file, sizeof(header));
+    bool ok = validHeader(header, bytes) && resize(header.size);
+    if (ok)
+    {
+        std::memcpy(static_cast<void*>(mTable), static_cast<const char*>(file) + Header_bytes,
+                    mClusters * sizeof(Cluster));
+        mGeneration = header.generation & 0x3F;
+    }
+
+    munmap(file, bytes);
+    return ok;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        std::cout << "info string failed to open hash file " << path << std::endl;
+        return false;
+    }
+
+    const std::size_t bytes = file.tellg();
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !validHeader(header, bytes) || !resize(header.size))
+        return false;
+
+    file.seekg(Header_bytes);
+    file.read(reinterpret_cast<char*>(mTable), mClusters * sizeof(Cluster));
+    mGeneration = header.generation & 0x3F;
+    return static_cast<bool>(file);
+#endif
+}
@@ -3,19 +3,31 @@
 
 #include "bitboard.h"
 #include "move.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
-#include <vector>
+#include <string>
 
-const int Default_size = 1024;
+const int Default_size = 1;                      // Default hash size in MiB.
+const int Max_size = 65536;                      // Max hash size in MiB.
+const int Cluster_size = 5;                      // Entries per cluster.
+const int No_eval = INT16_MIN;                   // Static eval not stored.
 
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// A decoded transposition table entry. This is what probe hands back to the  //
+// search, the table itself stores entries packed.                            //
+//                                                                            //
+// -------------------------------------------------------------------------- //
 struct TableEntry
 {
-    U64 key;
     Move best;
     NodeType type;
-    int depth;  
+    int depth;
     int score;
-    bool ancient;
+    int eval;
+    int generation;
 };
 
 inline std::ostream& operator<<(std::ostream& o, const TableEntry& tableEntry)
@@ -23,76 +35,268 @@ inline std::ostream& operator<<(std::ostream& o, const TableEntry& tableEntry)
     o << "Best Move: " << toString(tableEntry.best) << '\n'
       << "    Depth: " << tableEntry.depth << '\n'
       << "    Score: " << tableEntry.score << '\n'
-      << "     Node: " << (tableEntry.type == pv  ? "PV" 
-                         : tableEntry.type == cut ? "CUT" 
+      << "     Eval: " << tableEntry.eval << '\n'
+      << "     Node: " << (tableEntry.type == pv  ? "PV"
+                         : tableEntry.type == cut ? "CUT"
                          : "ALL")
       << '\n';
 
       return o;
 }
 
-class TranspositionTable
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// One cache line of the table. Each entry is a 32 bit key check and a 64     //
+// bit data word laid out as:                                                 //
+//                                                                            //
+//   bits  0-15  best move                                                    //
+//   bits 16-31  score                                                        //
+//   bits 32-47  static eval                                                  //
+//   bits 48-55  depth                                                        //
+//   bits 56-57  node type                                                    //
+//   bits 58-63  generation                                                   //
+//                                                                            //
+// The key checks and data words are kept in separate arrays so every data    //
+// word stays 8 byte aligned. Five entries fit in 64 bytes.                   //
+//                                                                            //
+// The table is shared by all search threads without a lock. Each word is     //
+// written atomically but a key check and its data word can still come from   //
+// two different stores. To catch that the key check is the top 32 bits of    //
+// the key xor a fold of the data word, so a torn pair fails verification and //
+// the probe is treated as a miss.                                            //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct Cluster
 {
-public:
-    TranspositionTable()
-    {
-        table.resize(Default_size);
-    }
-    ~TranspositionTable() {}
-    const TableEntry* probe(U64 key) const
-    {
-        return table.data() + key % table.size();
-    }
-    TableEntry& operator[](U64 key)
+    std::atomic<U64> data[Cluster_size];
+    std::atomic<uint32_t> key[Cluster_size];
+    uint32_t padding;
+};
+
+static_assert(sizeof(Cluster) == 64, "Cluster must fill one cache line");
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Counters for judging how well the table works at a given size. Each search //
+// thread keeps its own copy and passes it to probe and store, so the shared  //
+// table itself is never written to for bookkeeping.                          //
+//                                                                            //
+//   probes      calls to probe                                               //
+//   hits        probes that found the position                               //
+//   cutoffs     hits the search could return from                            //
+//   collisions  stores that evicted a different position of this search      //
+//   overwrites  evicted live entries, by their bound type                    //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+struct TableStats
+{
+    TableStats() : probes(0), hits(0), cutoffs(0), collisions(0), overwrites{} {}
+    TableStats& operator+=(const TableStats& o)
     {
-        return table[key % table.size()];
+        probes += o.probes;
+        hits += o.hits;
+        cutoffs += o.cutoffs;
+        collisions += o.collisions;
+        for (int i = 0; i < 3; ++i)
+            overwrites[i] += o.overwrites[i];
+        return *this;
     }
-    void clear()
+    uint64_t probes, hits, cutoffs, collisions;
+    uint64_t overwrites[3];                      // Indexed by NodeType.
+};
+
+class TranspositionTable
+{
+public:
+    TranspositionTable();
+    ~TranspositionTable();
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+    bool probe(U64 key, TableEntry& entry, TableStats* stats = nullptr) const;
+    void prefetch(U64 key) const;
+    void store(U64 key, Move best, NodeType type, int depth, int score, int eval,
+               TableStats* stats = nullptr);
+    void newSearch();
+    void clear(int threads = 1);
+    bool resize(int size_mb);
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+    std::size_t size() const;
+    const char* pageType() const;
+    int hashfull() const;
+private:
+    static U64 pack(Move best, NodeType type, int depth, int score, int eval, int generation);
+    static TableEntry unpack(U64 data);
+    static int relativeAge(int generation, int current);
+    static uint32_t fold(U64 data);
+    Cluster* cluster(U64 key) const;
+
+    void* mMemory;
+    std::size_t mBytes;
+    int mPages;
+    Cluster* mTable;
+    std::size_t mClusters;
+    int mSize;                                   // In MiB.
+    int mGeneration;
+};
+
+inline U64 TranspositionTable::pack(Move best, NodeType type, int depth,
+                                    int score, int eval, int generation)
+{
+    return static_cast<U64>(best)
+         | static_cast<U64>(static_cast<uint16_t>(score)) << 16
+         | static_cast<U64>(static_cast<uint16_t>(eval))  << 32
+         | static_cast<U64>(std::min(depth, 255))          << 48
+         | static_cast<U64>(type)                          << 56
+         | static_cast<U64>(generation)                    << 58;
+}
+
+inline TableEntry TranspositionTable::unpack(U64 data)
+{
+    TableEntry entry;
+    entry.best       = static_cast<Move>(data);
+    entry.score      = static_cast<int16_t>(data >> 16);
+    entry.eval       = static_cast<int16_t>(data >> 32);
+    entry.depth      = (data >> 48) & 0xFF;
+    entry.type       = static_cast<NodeType>((data >> 56) & 0x3);
+    entry.generation = data >> 58;
+    return entry;
+}
+
+// Number of searches since the entry was written, wrapping at 64.
+inline int TranspositionTable::relativeAge(int generation, int current)
+{
+    return (current - generation) & 0x3F;
+}
+
+inline uint32_t TranspositionTable::fold(U64 data)
+{
+    return static_cast<uint32_t>(data ^ (data >> 32));
+}
+
+// Map the low 32 bits of the key onto [0, mClusters) with a multiply and a
+// shift instead of a division. The high 32 bits are left for verification.
+inline Cluster* TranspositionTable::cluster(U64 key) const
+{
+    return mTable + (((key & 0xFFFFFFFF) * mClusters) >> 32);
+}
+
+// Called once per search. Entries written before this are treated as older,
+// so deep results from previous moves are kept until something fresher
+// needs the slot.
+inline void TranspositionTable::newSearch()
+{
+    mGeneration = (mGeneration + 1) & 0x3F;
+}
+
+// Start loading the cluster for key so a probe soon after doesn't stall.
+inline void TranspositionTable::prefetch(U64 key) const
+{
+    ::prefetch(cluster(key));
+}
+
+inline std::size_t TranspositionTable::size() const
+{
+    return mClusters * Cluster_size;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Look for the position in its cluster. The top 32 bits of the key are used  //
+// for verification, the low bits already picked the cluster. The entry is    //
+// copied out of the table, so later stores by other threads can't change it  //
+// under the search.                                                          //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+inline bool TranspositionTable::probe(U64 key, TableEntry& entry, TableStats* stats) const
+{
+    const Cluster* c = cluster(key);
+    const uint32_t key32 = key >> 32;
+
+    if (stats)
+        ++stats->probes;
+
+    for (int i = 0; i < Cluster_size; ++i)
     {
-        for (TableEntry& tableEntry : table)
+        U64 data = c->data[i].load(std::memory_order_relaxed);
+        uint32_t check = c->key[i].load(std::memory_order_relaxed);
+        if (data && (check ^ fold(data)) == key32)
         {
-            tableEntry.key     = 0;
-            tableEntry.best    = nullMove;
-            tableEntry.type    = pv;
-            tableEntry.depth   = 0;
-            tableEntry.score   = 0;
-            tableEntry.ancient = true;
+            entry = unpack(data);
+            if (stats)
+                ++stats->hits;
+            return true;
         }
     }
-    void setAncient()
-    {
-        for (TableEntry& tableEntry : table)
-            tableEntry.ancient = true;
-    }
-    std::size_t size() const
-    {
-        return table.size();
-    }
-    void resize(int size_mb)
-    {
-        table.clear();
-        table.resize(size_mb * 1000 * 1000 / sizeof(TableEntry));
-        clear();
-    }
-    void store(U64 key, Move best, NodeType type, int depth, int score)
+    return false;
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+// Store a search result. If the position is already in the cluster it is     //
+// updated in place, unless the old result is deeper, from this search, and   //
+// the new one is not exact. Otherwise the entry with the lowest              //
+// depth - 8 * age is replaced, so shallow entries and entries from old       //
+// searches go first.                                                         //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+inline void TranspositionTable::store(U64 key, Move best, NodeType type,
+                                      int depth, int score, int eval,
+                                      TableStats* stats)
+{
+    Cluster* c = cluster(key);
+    const uint32_t key32 = key >> 32;
+    int replace = 0;
+    int worst = INT32_MAX;
+    bool evict = true;
+    TableEntry victim;
+
+    for (int i = 0; i < Cluster_size; ++i)
     {
-        int i = key % table.size();
-        if (table[i].depth < depth ||
-            table[i].ancient ||
-            type == pv)
+        U64 data = c->data[i].load(std::memory_order_relaxed);
+        uint32_t check = c->key[i].load(std::memory_order_relaxed);
+        if (!data || (check ^ fold(data)) == key32)
+        {
+            if (data)
+            {
+                TableEntry old = unpack(data);
+                if (old.depth > depth && type != pv && old.generation == mGeneration)
+                    return;
+                if (best == nullMove)
+                    best = old.best;
+                if (eval == No_eval)
+                    eval = old.eval;
+            }
+            replace = i;
+            evict = false;
+            break;
+        }
+
+        TableEntry old = unpack(data);
+        int value = old.depth - 8 * relativeAge(old.generation, mGeneration);
+        if (value < worst)
         {
-            table[i].key     = key;
-            table[i].best    = best;
-            table[i].type    = type;
-            table[i].depth   = depth;
-            table[i].score   = score;
-            table[i].ancient = false;
+            worst = value;
+            replace = i;
+            victim = old;
         }
     }
-private:
-    std::vector<TableEntry> table;
-};
+
+    // Every slot held another position, one of them is being evicted.
+    if (stats && evict)
+    {
+        ++stats->overwrites[victim.type];
+        if (victim.generation == mGeneration)
+            ++stats->collisions;
+    }
+
+    score = std::max(INT16_MIN + 1, std::min(score, static_cast<int>(INT16_MAX)));
+
+    U64 data = pack(best, type, depth, score, eval, mGeneration);
+    c->key[replace].store(key32 ^ fold(data), std::memory_order_relaxed);
+    c->data[replace].store(data, std::memory_order_relaxed);
+}
 
 extern TranspositionTable ttable;
 
-#endif
\ No newline at end of file
+#endif
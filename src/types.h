@@ -3,6 +3,7 @@
 
 #define NDEBUG
 
+#include <cstdint>
 #include <string>
 #include <assert.h>
 
@@ -50,13 +51,47 @@ enum GameStage
     late
 };
 
-enum Color 
+// ----------------------------------------------------------------------------
+// A middle game and an end game value packed in one int, the end game value
+// in the upper 16 bits. Scores add, subtract and scale by an int as one
+// operation on both halves, and are only split up when tapered by the game
+// phase.
+// ----------------------------------------------------------------------------
+
+enum Score : int
+{
+    Score_zero
+};
+
+constexpr Score make_score(int mg, int eg)
+{
+    return static_cast<Score>(static_cast<int>(static_cast<unsigned>(eg) << 16) + mg);
+}
+
+constexpr int mg_value(Score s)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(static_cast<unsigned>(s)));
+}
+
+constexpr int eg_value(Score s)
+{
+    return static_cast<int16_t>(static_cast<uint16_t>(static_cast<unsigned>(s + 0x8000) >> 16));
+}
+
+// Interpolate between the two halves, phase 0 is the middle game and 256 the
+// end game.
+constexpr int taper(Score s, int phase)
+{
+    return (mg_value(s) * (256 - phase) + eg_value(s) * phase) / 256;
+}
+
+enum Color : uint8_t
 { 
     white, 
     black 
 };
 
-enum PieceType
+enum PieceType : uint8_t
 {
     pawn,
     knight,
@@ -85,7 +120,7 @@ static const int PieceValue[] =
     0
 };
 
-enum Square : uint32_t
+enum Square : uint8_t
 {
     H1, G1, F1, E1, D1, C1, B1, A1,
     H2, G2, F2, E2, D2, C2, B2, A2,
@@ -141,7 +176,7 @@ enum CR
     b_queen_castle = 8
 };
 
-static const int Score[Types_size][Types_size] = 
+static const int Mvv_lva[Types_size][Types_size] = 
 {
     { 26, 30, 31, 33, 36, 0 },  
     { 20, 25, 27, 29, 35, 0 },  
@@ -163,7 +198,7 @@ enum Dir
     SW = -7
 };
 
-const std::string SQ[64] =
+const char* const SQ[64] =
 {
     "h1", "g1", "f1", "e1", "d1", "c1", "b1", "a1",
     "h2", "g2", "f2", "e2", "d2", "c2", "b2", "a2",
@@ -210,6 +245,12 @@ enum NodeType
 inline Square& operator++(Square& s) { return s = static_cast<Square>(static_cast<int>(s) + 1); }
 inline PieceType& operator++(PieceType& p) { return p = static_cast<PieceType>(static_cast<int>(p) + 1); }
 inline File& operator++(File& f) { return f = static_cast<File>(static_cast<int>(f) + 1); }
+constexpr Score operator+(Score s1, Score s2) { return static_cast<Score>(static_cast<int>(s1) + static_cast<int>(s2)); }
+constexpr Score operator-(Score s1, Score s2) { return static_cast<Score>(static_cast<int>(s1) - static_cast<int>(s2)); }
+constexpr Score operator-(Score s) { return static_cast<Score>(-static_cast<int>(s)); }
+constexpr Score operator*(Score s, int i) { return static_cast<Score>(static_cast<int>(s) * i); }
+inline Score& operator+=(Score& s1, Score s2) { return s1 = s1 + s2; }
+inline Score& operator-=(Score& s1, Score s2) { return s1 = s1 - s2; }
 inline Color operator!(const Color c) { return static_cast<Color>(!static_cast<bool>(c)); }
 inline Square operator+(const Square s, const int i) { return static_cast<Square>(static_cast<int>(s) + i); }
 inline Square operator-(const Square s, const int i) { return static_cast<Square>(static_cast<int>(s) - i); }
@@ -1,5 +1,13 @@
 #include "uci.h"
+#include "test.h"
 #include <fstream>
+#include <thread>
+
+// Moves played so far, used for repetition detection in the search.
+static History gameHistory;
+static std::string hashFile;
+static std::string evalFile = "clevergirl.nnue";
+static bool useNNUE = false;
 
 // Check if a move given by the uci is valid.
 Move get_uci_move(std::string & token, State & s)
@@ -69,9 +77,9 @@ void go(std::istringstream & is, State & s)
     search_info.clock.set();
     if (!search_info.moveTime)
         search_info.moveTime = allocate_time(search_info.time[s.getOurColor()], 
-                                              history.size() / 2, 
+                                              gameHistory.size() / 2, 
                                               search_info.moves_to_go);
-    setup_search(s, search_info);
+    setup_search(s, search_info, gameHistory);
 }
 
 void position(std::istringstream & is, State & s)
@@ -81,8 +89,8 @@ void position(std::istringstream & is, State & s)
     bool start_flag = false;
 
     s = State(Start_fen);
-    history.init();
-    history.push(std::make_pair(nullMove, s.getKey()));
+    gameHistory.init();
+    gameHistory.push(std::make_pair(nullMove, s.getKey()));
 
     is >> token;
     if (token == "fen")
@@ -112,7 +120,7 @@ void position(std::istringstream & is, State & s)
         else
         {
             s.make_t(m);
-            history.push(std::make_pair(m, s.getKey()));
+            gameHistory.push(std::make_pair(m, s.getKey()));
         }
     }
     // If start flag is false, initialize board state with fen string.
@@ -120,16 +128,163 @@ void position(std::istringstream & is, State & s)
         s = State(fen);
 }
 
+// Switch the network evaluation on or off, loading the EvalFile network the
+// first time it is needed. Stored evals came from another evaluation, so the
+// hash and the eval caches are cleared whenever the evaluation changes.
+void set_nnue(bool reload)
+{
+    bool load = useNNUE && (reload || !NNUE::loaded());
+    if (load && NNUE::load(evalFile))
+        std::cout << "info string loaded network " << evalFile << std::endl;
+
+    bool enabled = useNNUE && NNUE::loaded();
+    if (load || enabled != NNUE::enabled)
+    {
+        ttable.clear(threadCount);
+        clear_caches();
+    }
+    NNUE::enabled = enabled;
+
+    std::cout << "info string using "
+              << (enabled ? std::string("nnue evaluation (") + NNUE::simd() + ")"
+                          : std::string("classical evaluation"))
+              << std::endl;
+}
+
 void set_option(std::string & name, std::string & value)
 {
     if (name == "Hash")
-        ttable.resize(std::stoi(value));
+    {
+        int size = std::max(1, std::min(std::stoi(value), Max_size));
+        if (ttable.resize(size))
+        {
+            ttable.clear(threadCount);
+            std::cout << "info string hash " << size << " MiB using "
+                      << ttable.pageType() << std::endl;
+        }
+    }
+    else if (name == "Threads")
+        threadCount = std::max(1, std::min(std::stoi(value), Max_threads));
+    else if (name == "PawnHash")
+        pawnHashSize = std::max(1, std::min(std::stoi(value), Max_pawn_size));
+    else if (name == "EvalCache")
+        useEvalCache = value == "true";
+    else if (name == "HashFile")
+        hashFile = value;
     else if (name == "ClearHash")
-        ttable.clear();
+        ttable.clear(threadCount);
+    else if (name == "UseNNUE")
+    {
+        useNNUE = value == "true";
+        set_nnue(false);
+    }
+    else if (name == "EvalFile")
+    {
+        evalFile = value;
+        if (useNNUE)
+            set_nnue(true);
+    }
 
     return;
 }
 
+// Benchmarks for measuring engine performance.
+//   bench ttd [depth]    time to depth for 1, 2, 4, ... threads.
+//   bench tt [threads]   concurrent store/probe stress test of the hash.
+//   bench nnue           network accumulator check and eval speed.
+//   bench eval           make_t and Evaluate throughput.
+//   bench sliders [depth] magic against pext attack lookups and perft.
+//   bench latency [mb]   slider lookup latency under hash table pressure.
+//   bench alloc [depth]  heap allocations made during search (make allocs).
+//   bench make [depth]   perft and search speed of the make scheme built in.
+//   bench state          size of State and the cost of copying one.
+//   bench verify         incremental checkers and pins against a recompute.
+//   bench see            seeGe against see on a capture corpus, and speed.
+void bench(std::istringstream & is)
+{
+    std::string token;
+    int depth, threads, size;
+
+    is >> token;
+    if (token == "ttd")
+    {
+        if (!(is >> depth))
+            depth = 8;
+        ttdBench(depth);
+    }
+    else if (token == "tt")
+    {
+        if (!(is >> threads))
+            threads = std::max(4u, std::thread::hardware_concurrency());
+        ttStressTest(threads);
+    }
+    else if (token == "nnue")
+        nnueBench();
+    else if (token == "eval")
+        evalBench();
+    else if (token == "sliders")
+    {
+        if (!(is >> depth))
+            depth = 4;
+        sliderBench(depth);
+    }
+    else if (token == "latency")
+    {
+        if (!(is >> size))
+            size = 256;
+        sliderLatencyBench(size);
+    }
+    else if (token == "alloc")
+    {
+        if (!(is >> depth))
+            depth = 8;
+        allocBench(depth);
+    }
+    else if (token == "make")
+    {
+        if (!(is >> depth))
+            depth = 8;
+        makeBench(depth);
+    }
+    else if (token == "state")
+        stateBench();
+    else if (token == "verify")
+        perftTestVerify();
+    else if (token == "see")
+        seeBench();
+    else
+        std::cout << "unknown bench: " << token << '\n';
+}
+
+// Hash table, eval cache and lazy eval counters summed over all threads for
+// the last search.
+void stats()
+{
+    TableStats st = table_stats();
+    uint64_t evalProbes, evalHits;
+    eval_cache_stats(evalProbes, evalHits);
+    uint64_t evals, lazyEvals;
+    lazy_eval_stats(evals, lazyEvals);
+
+    std::cout << "info string hash probes " << st.probes
+              << " hits " << st.hits
+              << " (" << (st.probes ? st.hits * 100 / st.probes : 0) << "%)"
+              << " cutoffs " << st.cutoffs
+              << " collisions " << st.collisions
+              << " overwrites pv " << st.overwrites[pv]
+              << " cut " << st.overwrites[cut]
+              << " all " << st.overwrites[all]
+              << " hashfull " << ttable.hashfull() << std::endl;
+    std::cout << "info string eval cache probes " << evalProbes
+              << " hits " << evalHits
+              << " (" << (evalProbes ? evalHits * 100 / evalProbes : 0) << "%)"
+              << std::endl;
+    std::cout << "info string lazy evals " << lazyEvals
+              << " of " << evals
+              << " (" << (evals ? lazyEvals * 100 / evals : 0) << "%)"
+              << std::endl;
+}
+
 void uci()
 {
     State root(Start_fen);
@@ -151,7 +306,16 @@ void uci()
         {
             std::cout << "id name Clever Girl" << std::endl
                       << "id author Seth Kasmann" << std::endl
-                      << "option name Hash type spin default 1 min 1 max 128" << std::endl;
+                      << "option name Hash type spin default " << Default_size
+                      << " min 1 max " << Max_size << std::endl
+                      << "option name Threads type spin default 1 min 1 max "
+                      << Max_threads << std::endl
+                      << "option name PawnHash type spin default " << Default_pawn_size
+                      << " min 1 max " << Max_pawn_size << std::endl
+                      << "option name EvalCache type check default true" << std::endl
+                      << "option name HashFile type string default <empty>" << std::endl
+                      << "option name UseNNUE type check default false" << std::endl
+                      << "option name EvalFile type string default " << evalFile << std::endl;
             std::cout << "uciok" << std::endl;
         }
         else if (token == "setoption")
@@ -166,9 +330,27 @@ void uci()
 
             set_option(name, value);
         }
+        else if (token == "ucinewgame")
+        {
+            ttable.clear(threadCount);
+            clear_caches();
+        }
         else if (token == "position")
             position(is, root);
         else if (token == "go")
             go(is, root);
+        else if (token == "bench")
+            bench(is);
+        else if (token == "stats")
+            stats();
+        else if (token == "savehash" || token == "loadhash")
+        {
+            if (hashFile.empty())
+                std::cout << "info string set the HashFile option first" << std::endl;
+            else if (token == "savehash" && ttable.save(hashFile))
+                std::cout << "info string saved hash to " << hashFile << std::endl;
+            else if (token == "loadhash" && ttable.load(hashFile))
+                std::cout << "info string loaded hash from " << hashFile << std::endl;
+        }
     }
 }
\ No newline at end of file
@@ -11,7 +11,7 @@
 #include "search.h"
 #include "timer.h"
 
-const std::string Start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq";
+const char* const Start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq";
 
 void uci();
 
@@ -2,35 +2,57 @@
 
 namespace Zobrist
 {
-	U64 piece_rand[Player_size][Types_size][Board_size];
-	U64 ep_file_rand[8];
-	U64 castle_rand[16];
-	U64 side_to_move_rand;
-
-	U64 rand_64()
+	namespace
 	{
-		return U64(rand()) << 32 | U64(rand());
-	}
+		// SplitMix64, small enough to run in a constexpr function and the
+		// same on every compiler and C library.
+		constexpr U64 rand_64(U64& state)
+		{
+			U64 z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
 
-	void init()
-	{
-		srand(6736199);
-		for (PieceType p = pawn; p < none; ++p)
+		constexpr Keys make_keys()
 		{
-			for (Square s = first_sq; s <= last_sq; ++s)
+			Keys k{};
+			U64 state = Seed;
+			for (int p = pawn; p < none; ++p)
+			{
+				for (int s = first_sq; s <= last_sq; ++s)
+				{
+					k.piece_rand[white][p][s] = rand_64(state);
+					k.piece_rand[black][p][s] = rand_64(state);
+				}
+			}
+			for (int f = a_file; f <= h_file; ++f)
+			{
+				k.ep_file_rand[f] = rand_64(state);
+			}
+			for (int i = 0; i < 16; ++i)
 			{
-				piece_rand[white][p][s] = rand_64();
-				piece_rand[black][p][s] = rand_64();
+				k.castle_rand[i] = rand_64(state);
 			}
+			k.side_to_move_rand = rand_64(state);
+			return k;
 		}
+	}
+
+	constexpr Keys keys = make_keys();
+
+	// A hash of every key, so a hash file written by a build with a
+	// different seed or generator is rejected even if the seed matches.
+	U64 fingerprint()
+	{
+		U64 h = keys.side_to_move_rand;
+		for (PieceType p = pawn; p < none; ++p)
+			for (Square s = first_sq; s <= last_sq; ++s)
+				h = (h ^ keys.piece_rand[white][p][s] ^ (keys.piece_rand[black][p][s] << 1)) * 0x9E3779B97F4A7C15ull;
 		for (File f = a_file; f <= h_file; ++f)
-		{
-			ep_file_rand[f] = rand_64();
-		}
+			h = (h ^ keys.ep_file_rand[f]) * 0x9E3779B97F4A7C15ull;
 		for (int i = 0; i < 16; ++i)
-		{
-			castle_rand[i] = rand_64();
-		}
-		side_to_move_rand = rand_64();
+			h = (h ^ keys.castle_rand[i]) * 0x9E3779B97F4A7C15ull;
+		return h;
 	}
-};
\ No newline at end of file
+};
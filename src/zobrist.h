@@ -8,41 +8,48 @@
 
 namespace Zobrist
 {
-	extern U64 piece_rand[Player_size][Types_size][Board_size];
-	extern U64 ep_file_rand[8];
-	extern U64 castle_rand[16];
-	extern U64 side_to_move_rand;
+	const unsigned Seed = 6736199;
 
-	void init();
+	struct Keys
+	{
+		U64 piece_rand[Player_size][Types_size][Board_size];
+		U64 ep_file_rand[8];
+		U64 castle_rand[16];
+		U64 side_to_move_rand;
+	};
+
+	extern const Keys keys;
+
+	U64 fingerprint();
 
 	// Side to move.
 	inline U64 key()
 	{
-		return side_to_move_rand;
+		return keys.side_to_move_rand;
 	}
 
 	// Castle rights.
 	inline U64 key(int castle)
 	{
-		return castle_rand[castle];
+		return keys.castle_rand[castle];
 	}
 
 	// En-passant file.
 	inline U64 key(File ep)
 	{
-		return ep_file_rand[ep];
+		return keys.ep_file_rand[ep];
 	}
 
 	// Remove/add a piece.
 	inline U64 key(Color c, PieceType p, Square src)
 	{
-		return piece_rand[c][p][src];
+		return keys.piece_rand[c][p][src];
 	}
 
 	// Moving a piece.
 	inline U64 key(Color c, PieceType p, Square src, Square dst)
 	{
-		return piece_rand[c][p][src] ^ piece_rand[c][p][dst];
+		return keys.piece_rand[c][p][src] ^ keys.piece_rand[c][p][dst];
 	}
 
 };